@@ -3,6 +3,8 @@
 #include "HighSeqModule.hpp"
 #include "MasterStep.hpp"
 #include "Sequencer.hpp"
+#include "SongProgram.hpp"
+#include "StepOrder.hpp"
 
 //#include <iostream>
 using namespace std;
@@ -16,21 +18,41 @@ namespace CLC_Synths {
 		NO = 0,
 		YES,
 	};
+	enum INVARIANT {   // bits returned by HighSeqModule::checkInvariants()
+		INVARIANT_MASTERSTEP = 1,   // master step out of range, or switched off after processing
+		INVARIANT_STEP = 2,         // a step's sequencer is out of range or its repeat count is off
+		INVARIANT_SEQUENCER = 4,    // a sequencer counted past its target without a reset pending
+	};
 	class HighSeqModule {
 	public:
 		// const
 		static const int NUM_STEPS = 8;       // number of steps in the master sequencer
 		static const int NUM_SEQUENCERS = 8; // number of sequencers being sequenced
-		static const int MAX_REPEATS = 16;    // max number of repeats allowed
+		static const int MAX_REPEATS = MasterStep::MAX_REPEATS;    // max number of repeats allowed
+		static const int MAX_PASS_VISITS = 64; // step visits of one pass that passSteps() and songLength() look at
+		static_assert(NUM_STEPS == StepOrder::MAX_STEPS, "one order table entry per step");
 	private:
 		// state
 		INITSTATE moduleState;
 
 		int masterStep;
+		const SongProgram* program;   // arrangement replacing the step ring, nullptr = steps in turn
+		ProgramCursor cursor;
+		StepOrder order;              // play order of the steps when there is no program
+		int position;                 // masterStep's place in order, -1 when no step is running
+		int orderMode;                // STEPORDER
+		uint32_t orderSeed;
+		unsigned stepMask;            // Step Mask CV: steps that may come up next
+		int repeatOffset;             // Repeats CV
 
 		// methods
 		int findFirstSwitch() const;
-		int findNextStep() const;
+		int findNextStep(bool* passStart = nullptr) const;
+		int findStepFrom(int step) const;
+		int advanceStep();
+		void syncPosition();
+		void resetPendingSequencers();
+		void countBeats(bool countRepeats);
 
 	public:
 		// state
@@ -42,10 +64,30 @@ namespace CLC_Synths {
 		HighSeqModule();
 		bool guard() const;
 		int getMasterStep() const { return masterStep; }
+		void setProgram(const SongProgram* p_program);
+		void setOrder(int p_mode, uint32_t p_seed);
+		void refreshOrder();
+		void setModulation(int p_repeatOffset, int p_barsOffset, unsigned p_stepMask);
+		bool passStarted() const;
+		bool stepEnding() const;
+		bool nextStartsPass() const;
+		bool passEnding() const;
+		int passSteps(int8_t* visits, int maxVisits) const;
 		int getState() const { return moduleState; }
 		void assertInitialized();
+		bool isIdle() const;
+		bool hasPendingResets() const;
+		int upcomingStep() const;
+		int checkInvariants() const;
+		int songLength() const;
+		int stepLength() const;
+		int stepPosition() const;
+		unsigned switchMask() const;
         void reset(); 
+		void jump(int step);
+		void requestSequencerResets();
 		void process(); // process one microcontroller loop frame
+		void follow(int step); // process one frame with the master step supplied by a leader
 	};
 
 	HighSeqModule::HighSeqModule() {
@@ -54,8 +96,15 @@ namespace CLC_Synths {
 
 		// indicates no step has started when -1
 		masterStep = -1;
+		program = nullptr;
+		position = -1;
+		orderMode = ORDER_FORWARD;
+		orderSeed = 0;
+		stepMask = ~0u;
+		repeatOffset = 0;
 
 		for (int sw = 0; sw < NUM_STEPS; sw++) steps[sw].set_switch (SWITCHSTATE::ON);
+		order.build(switchMask(), orderMode, orderSeed, 0);
 	}
 
 	bool HighSeqModule::guard() const {
@@ -83,31 +132,255 @@ namespace CLC_Synths {
 	}
 
 
-	int HighSeqModule::findNextStep() const {
-		int step = masterStep;
-		int firstSwitch = -1;
+	bool HighSeqModule::isIdle() const {
+		// true when process() would change nothing until the next beat edge or reset;
+		// lets the caller skip per frame processing between edges
+		if (!guard())
+			return true;
+		if (masterStep == -1)
+			return (findNextStep() == -1);
+		if (steps[masterStep].getOnOffSwitch() == SWITCHSTATE::OFF)
+			return false;
+		if (steps[masterStep].getRepeatState() == REPEATSTATE::COMPLETE)
+			return false;
+		return !hasPendingResets();
+	}
 
-		if (masterStep == -1) {
-			firstSwitch = findFirstSwitch();
-			if (firstSwitch == -1)
-				return (-1);
-			else
-				return (firstSwitch);
+	bool HighSeqModule::hasPendingResets() const {
+		for (int s = 0; s < NUM_SEQUENCERS; s++) {
+			if (sequencers[s].getResetStatus() == SEQRESET::RESET)
+				return true;
 		}
+		return false;
+	}
 
-		bool found = false;
-		if (++step >= NUM_STEPS) step = 0; // circular
-		while (!found && (step != masterStep)) {
-			if (steps[step].getOnOffSwitch() == SWITCHSTATE::ON) {
-				found = true;
-				return step;
+	int HighSeqModule::checkInvariants() const {
+		// only meaningful after process()/follow(): parameter changes may break these until the next frame
+		int failed = 0;
+		if (!guard())
+			return 0;
+		if ((masterStep < -1) || (masterStep >= NUM_STEPS))
+			failed |= INVARIANT_MASTERSTEP;
+		else if ((masterStep >= 0) && (steps[masterStep].getOnOffSwitch() == SWITCHSTATE::OFF))
+			failed |= INVARIANT_MASTERSTEP;
+		for (int step = 0; step < NUM_STEPS; step++) {
+			int seq = steps[step].getAssignedSeq();
+			if ((seq < 0) || (seq >= NUM_SEQUENCERS) || !steps[step].isConsistent())
+				failed |= INVARIANT_STEP;
+		}
+		for (int s = 0; s < NUM_SEQUENCERS; s++) {
+			if (!sequencers[s].isConsistent())
+				failed |= INVARIANT_SEQUENCER;
+		}
+		return failed;
+	}
+
+	int HighSeqModule::songLength() const {
+		// beats in one pass through the switched on steps, or through the program; 0 if none is on.
+		// Every visit is counted as it will play when it next starts, with the Repeats and Bars CVs the running
+		// step and counts have not taken yet, so the length only moves with the song and its modulation
+		int8_t visits[MAX_PASS_VISITS];
+		int count = passSteps(visits, MAX_PASS_VISITS);
+		int beats = 0;
+		for (int visit = 0; visit < count; visit++) {
+			const MasterStep& step = steps[visits[visit]];
+			beats += (step.getRepeats(repeatOffset) + 1) * sequencers[step.getAssignedSeq()].getnextTargetBeats();
+		}
+		return beats;
+	}
+
+	int HighSeqModule::passSteps(int8_t* visits, int maxVisits) const {
+		// the steps one pass through the song plays, in order; returns how many, at most maxVisits
+		int count = 0;
+		if (program) {
+			ProgramCursor walk;
+			unsigned mask = switchMask();
+			while (count < maxVisits) {
+				int step = program->next(walk, mask);
+				if ((step == -1) || ((count > 0) && walk.passStart))
+					break;
+				visits[count++] = step;
 			}
-			if (++step >= NUM_STEPS) step = 0;
+			return count;
 		}
-		// If no other step is ON, check if current masterStep is ON
-		if (steps[masterStep].getOnOffSwitch() == SWITCHSTATE::ON)
-			return masterStep;
-		return -1; // No active steps found
+		// the table as it will be once the audio thread picks up a switch change
+		StepOrder fresh;
+		const StepOrder* walk = &order;
+		if (!order.builtFor(switchMask(), orderMode, orderSeed)) {
+			fresh.build(switchMask(), orderMode, orderSeed, order.getPass());
+			walk = &fresh;
+		}
+		for (int at = 0; (at < walk->size()) && (count < maxVisits); at++)
+			visits[count++] = walk->at(at);
+		return count;
+	}
+
+	unsigned HighSeqModule::switchMask() const {
+		// one bit per step switched on and let through by the Step Mask CV, bit 0 = step 1. A mask that
+		// would leave no step on lets them all through
+		unsigned mask = 0;
+		for (int step = 0; step < NUM_STEPS; step++) {
+			if (steps[step].getOnOffSwitch() == SWITCHSTATE::ON)
+				mask |= 1u << step;
+		}
+		return (mask & stepMask) ? (mask & stepMask) : mask;
+	}
+
+	void HighSeqModule::setModulation(int p_repeatOffset, int p_barsOffset, unsigned p_stepMask) {
+		// the CV inputs, once per block. Every step but the running one takes the repeats at once, so a step's
+		// length is fixed when it starts; a sequencer takes the bars when its count next restarts; the mask
+		// only decides which steps come up next, the running step always plays out
+		stepMask = p_stepMask;
+		repeatOffset = p_repeatOffset;
+		for (int step = 0; step < NUM_STEPS; step++) {
+			if (step != masterStep)
+				steps[step].set_repeatOffset(repeatOffset);
+		}
+		for (int s = 0; s < NUM_SEQUENCERS; s++)
+			sequencers[s].set_barsOffset(p_barsOffset);
+	}
+
+	int HighSeqModule::findStepFrom(int step) const {
+		// the first step switched on at or after step, wrapping round; -1 if none is on.
+		// The mask is doubled so one shift and a count of trailing zeros replace a walk round the steps
+		unsigned mask = switchMask();
+		if (mask == 0)
+			return -1;
+		unsigned from = ((mask | (mask << NUM_STEPS)) >> step);
+		return (step + __builtin_ctz(from)) % NUM_STEPS;
+	}
+
+	int HighSeqModule::stepLength() const {
+		// beats in one visit of the running step, repeats included; 0 if none is running
+		if (!guard() || (masterStep == -1))
+			return 0;
+		const MasterStep& step = steps[masterStep];
+		return (step.getRepeats() + 1) * sequencers[step.getAssignedSeq()].gettargetBeats();
+	}
+
+	int HighSeqModule::stepPosition() const {
+		// beats of the running step's visit played so far, 0..stepLength(). A count that reached its target
+		// has its repeat counted already, so it reads as 0 until the sequencer reset clears it
+		if (!guard() || (masterStep == -1))
+			return 0;
+		const MasterStep& step = steps[masterStep];
+		const Sequencer& sequencer = sequencers[step.getAssignedSeq()];
+		int beats = (sequencer.getbeatCount() < sequencer.gettargetBeats()) ? sequencer.getbeatCount() : 0;
+		return step.getCountRepeats() * sequencer.gettargetBeats() + beats;
+	}
+
+	bool HighSeqModule::stepEnding() const {
+		// the next beat edge ends the running step's visit, or it has just ended
+		if (!guard() || (masterStep == -1))
+			return false;
+		const MasterStep& step = steps[masterStep];
+		if (step.getOnOffSwitch() == SWITCHSTATE::OFF)
+			return false;
+		if (step.getRepeatState() == REPEATSTATE::COMPLETE)
+			return true;
+		const Sequencer& sequencer = sequencers[step.getAssignedSeq()];
+		if (sequencer.getResetStatus() == SEQRESET::RESET)
+			return false;
+		return (step.getCountRepeats() >= step.getRepeats()) && (sequencer.getbeatCount() + 1 >= sequencer.gettargetBeats());
+	}
+
+	int HighSeqModule::upcomingStep() const {
+		// the step the running one hands over to if the next beat edge ends it (or it has just ended);
+		// -1 while more beats or repeats are left
+		return stepEnding() ? findNextStep() : -1;
+	}
+
+	bool HighSeqModule::nextStartsPass() const {
+		// the step after the running one starts a pass, or a program stops there. Holds for the whole visit,
+		// so callers can keep it until the step, the parameters or the modulation change
+		bool passStart = false;
+		int next = findNextStep(&passStart);
+		return passStart || (next == -1);
+	}
+
+	bool HighSeqModule::passEnding() const {
+		// the running step is about to end the pass: the song comes round to its start next, or a program stops
+		return stepEnding() && nextStartsPass();
+	}
+
+	bool HighSeqModule::passStarted() const {
+		// the running step opened a pass through the song
+		if (masterStep == -1)
+			return false;
+		return program ? cursor.passStart : (position == 0);
+	}
+
+	void HighSeqModule::setProgram(const SongProgram* p_program) {
+		// a program switched off and on again starts from its top at the next step boundary
+		if (!p_program)
+			cursor = ProgramCursor();
+		program = p_program;
+	}
+
+	void HighSeqModule::setOrder(int p_mode, uint32_t p_seed) {
+		orderMode = p_mode;
+		orderSeed = p_seed;
+		refreshOrder();
+	}
+
+	void HighSeqModule::refreshOrder() {
+		// rebuilds the order table if the switches, mode or seed changed since it was built. Audio thread
+		// only: called once per block and at each step boundary, never per frame
+		if (!order.builtFor(switchMask(), orderMode, orderSeed))
+			order.build(switchMask(), orderMode, orderSeed, order.getPass());
+		syncPosition();
+	}
+
+	void HighSeqModule::syncPosition() {
+		// position back on masterStep after a rebuild, a jump, a leader's step or a program switched off.
+		// A step switched off carries on to the next one on, as the ring always did
+		if (masterStep < 0) {
+			position = -1;
+			return;
+		}
+		if ((position >= 0) && (position < order.size()) && (order.at(position) == masterStep))
+			return;
+		int at = order.find(masterStep);
+		position = (at >= 0) ? at : order.resume(masterStep);
+	}
+
+	int HighSeqModule::findNextStep(bool* passStart) const {
+		// the step after the running one, without moving on. passStart: whether it begins a pass
+		if (program) {
+			ProgramCursor peek = cursor;
+			int step = program->next(peek, switchMask());
+			if (passStart)
+				*passStart = peek.passStart;
+			return step;
+		}
+		int next = position + 1;
+		if (order.size() == 0) {
+			if (passStart)
+				*passStart = false;
+			return -1;
+		}
+		if (passStart)
+			*passStart = (next == 0) || (next >= order.size());
+		return (next >= order.size()) ? order.firstOfNextPass() : order.at(next);
+	}
+
+	int HighSeqModule::advanceStep() {
+		// the step findNextStep() gives, and a program's cursor or the order position moved onto it
+		if (program)
+			return program->next(cursor, switchMask());
+		refreshOrder();
+		if (order.size() == 0) {
+			position = -1;
+			return -1;
+		}
+		int next = position + 1;
+		if (next >= order.size()) {
+			next = 0;
+			if (position >= 0)
+				order.seek(order.getPass() + 1);   // Random: the next pass's order
+		}
+		position = next;
+		return order.at(position);
 	}
 
 /*
@@ -140,46 +413,48 @@ namespace CLC_Synths {
 */
     void HighSeqModule::reset() {
         masterStep = -1; // ::process will determine the correct starting step  JULY 5 set to -1
-        masterStep = findNextStep(); // Set to first active step or -1 if none
-        for (int s = 0; s < NUM_SEQUENCERS; s++) 
-            sequencers[s].setReset();
+        for (int s = 0; s < NUM_STEPS; s++)
+            steps[s].reset();       // the running step's repeat count too, so every step plays all its repeats again
+        cursor = ProgramCursor();
+        position = -1;
+        order.seek(0);              // a reset replays the same Random order
+        masterStep = advanceStep(); // Set to first active step or -1 if none
+        requestSequencerResets();
     }
 
-	void HighSeqModule::process() {   // called once per micro controller main loop process
-		int s;
-		int nextStep = -1;
-		
-		if (!guard()) 
+	void HighSeqModule::jump(int step) {
+		// start step (or the next one switched on) from its first beat and first repeat at once, as if
+		// it had come round at the end of the running step
+		if (!guard())
 			return;
-		
-		if (masterStep >= 0) {  // handles case where user switches off the currently running step, find next step
-				if (steps[masterStep].getOnOffSwitch() == SWITCHSTATE::OFF)
-					masterStep = findNextStep();
-		}
-		else
-			masterStep = findNextStep(); 
+		if (masterStep >= 0)
+			steps[masterStep].reset();
+		masterStep = findStepFrom(step);
+		position = -1;
+		syncPosition();
+		if (masterStep == -1)
+			return;
+		steps[masterStep].reset();
+		sequencers[steps[masterStep].getAssignedSeq()].reset();
+	}
 
-		if (masterStep == -1) return;
+	void HighSeqModule::requestSequencerResets() {
+		// every sequencer restarts its beat count on the next frame
+		for (int s = 0; s < NUM_SEQUENCERS; s++)
+			sequencers[s].setReset();
+	}
 
-		
-		
-		// at end of step repeat cyle, advance the master step sequencer
-		if (steps[masterStep].getRepeatState() == REPEATSTATE::COMPLETE) {
-			steps[masterStep].reset();			
-			//sequencers[steps[masterStep].getAssignedSeq()].reset();
-			nextStep = findNextStep();
-		}
-	
-		// Reset sequencers 
-		for (s = 0; s < NUM_SEQUENCERS; s++) {
+	void HighSeqModule::resetPendingSequencers() {
+		for (int s = 0; s < NUM_SEQUENCERS; s++) {
 			if (sequencers[s].getResetStatus() == SEQRESET::RESET) {
 				// cout << "RESETING SEQUENCER for Seq: " << s << endl;
 				sequencers[s].reset();
 			}
 		}
+	}
 
-		// Count beats and repeats
-		for (s = 0; s < NUM_SEQUENCERS; s++) {
+	void HighSeqModule::countBeats(bool countRepeats) {
+		for (int s = 0; s < NUM_SEQUENCERS; s++) {
 			if (sequencers[s].getbeatState() == BEATSTATE::FIRSTHIGH) {
 				//if (masterStep == s) {
 					/*
@@ -196,7 +471,7 @@ namespace CLC_Synths {
 					cout << "	Resetstate: " << sequencers[s].getResetStatus() << endl;
 					*/
 				//}
-				if ((sequencers[s].getResetStatus() == SEQRESET::RESET) &&
+				if (countRepeats && (sequencers[s].getResetStatus() == SEQRESET::RESET) &&
 					(s == steps[masterStep].getAssignedSeq())) {
 					/*
 					cout << " 	Repeats: " << steps[s].getRepeats() << endl;
@@ -210,9 +485,71 @@ namespace CLC_Synths {
 					}
 			}
 		}
+	}
+
+	void HighSeqModule::process() {   // called once per micro controller main loop process
+		int nextStep = -1;
+		bool ended = false;
+		
+		if (!guard()) 
+			return;
+		
+		if (masterStep >= 0) {  // handles case where user switches off the currently running step, find next step
+				if (steps[masterStep].getOnOffSwitch() == SWITCHSTATE::OFF)
+					masterStep = advanceStep();
+		}
+		else
+			masterStep = advanceStep(); 
+
+		if (masterStep == -1) return;
+
+		
+		
+		// at end of step repeat cyle, advance the master step sequencer
+		if (steps[masterStep].getRepeatState() == REPEATSTATE::COMPLETE) {
+			steps[masterStep].reset();			
+			steps[masterStep].set_repeatOffset(repeatOffset);   // the only step on picks up the Repeats CV here
+			//sequencers[steps[masterStep].getAssignedSeq()].reset();
+			nextStep = advanceStep();
+			ended = (nextStep == -1);   // a program reached its End
+		}
+	
+		// Reset sequencers 
+		resetPendingSequencers();
+
+		// Count beats and repeats
+		countBeats(true);
+
 		if (nextStep != -1) {
 			masterStep = nextStep;
 			sequencers[steps[masterStep].getAssignedSeq()].reset();
+		} else if (ended)
+			masterStep = -1;
+	}
+
+	void HighSeqModule::follow(int step) {   // follower mode: the leader has already decided the master step
+		if (!guard()) 
+			return;
+
+		// a step switched off here rests this module while the leader plays that step
+		if ((step >= 0) && (steps[step].getOnOffSwitch() == SWITCHSTATE::OFF))
+			step = -1;
+
+		// picking up a step from none, or from a switched off step, happens before counting as in process()
+		if ((masterStep == -1) || (steps[masterStep].getOnOffSwitch() == SWITCHSTATE::OFF))
+			masterStep = step;
+
+		// Reset sequencers and count beats; repeats are the leader's business
+		resetPendingSequencers();
+		if (masterStep >= 0)
+			countBeats(false);
+
+		// a step change at the end of a repeat cycle restarts the new step's sequencer, as in process()
+		if (step != masterStep) {
+			masterStep = step;
+			if (masterStep >= 0)
+				sequencers[steps[masterStep].getAssignedSeq()].reset();
 		}
+		syncPosition();
 	}
 } // namespace
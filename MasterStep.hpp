@@ -12,10 +12,13 @@ namespace CLC_Synths {
 
     // Master Sequencer Step (1 of 8). Each step is assigned a sequencer to run for a set number of repeats
     class MasterStep {
+    public:
+        static const int MAX_REPEATS = 16;
     private:
         // inputs
         SWITCHSTATE onOffSwitch;
         int repeats;
+        int repeatOffset;   // Repeats CV, added to repeats; only changed while the step is not running
         int assignedSeq;
 
         // state
@@ -29,29 +32,44 @@ namespace CLC_Synths {
         void set_sequencer(int p_assignedSeq);
         void set_repeats(int p_repeats);
         void set_switch(SWITCHSTATE p_onOffSwitch);
+        void set_repeatOffset(int p_repeatOffset) { repeatOffset = p_repeatOffset; }
        
         REPEATSTATE getRepeatState() const { return repeatState; }
         int getAssignedSeq() const { return assignedSeq; }
-        int getRepeats() const { return repeats; }
+        int getRepeats() const;
+        int getRepeats(int p_repeatOffset) const;
         int getCountRepeats() const { return countRepeats; }
         SWITCHSTATE getOnOffSwitch() const { return onOffSwitch; }
 
         void reset();
         void countRepeat();
+        bool isConsistent() const;
     };
     MasterStep::MasterStep() {
         assignedSeq = 0;
         repeats = 0;
+        repeatOffset = 0;
         onOffSwitch = SWITCHSTATE::ON;
         reset();
     }
     MasterStep::MasterStep(int p_assignedSeq, int p_repeats, SWITCHSTATE p_onOffSwitch) {
         assignedSeq = p_assignedSeq;
         repeats = p_repeats;
+        repeatOffset = 0;
         onOffSwitch = p_onOffSwitch;
         reset();
     }
 
+    int MasterStep::getRepeats() const {
+        return getRepeats(repeatOffset);
+    }
+
+    int MasterStep::getRepeats(int p_repeatOffset) const {
+        // repeats as played: the parameter plus the Repeats CV, within 0..MAX_REPEATS
+        int played = repeats + p_repeatOffset;
+        return (played < 0) ? 0 : (played > MAX_REPEATS) ? MAX_REPEATS : played;
+    }
+
 	void MasterStep::set_sequencer(int p_assignedSeq) { 
 		if (assignedSeq == p_assignedSeq)
 			return;
@@ -78,11 +96,18 @@ namespace CLC_Synths {
         repeatState = REPEATSTATE::NOTCOMPLETE;
     }
 
+    bool MasterStep::isConsistent() const {
+        // a repeat cycle is complete exactly when the count has passed repeats, and never counts further
+        if ((countRepeats < 0) || (countRepeats > getRepeats() + 1))
+            return false;
+        return ((repeatState == REPEATSTATE::COMPLETE) == (countRepeats > getRepeats()));
+    }
+
     void MasterStep::countRepeat() {
         if (onOffSwitch == SWITCHSTATE::OFF)
             return;
 
-        if (++countRepeats > repeats) {  // the Master sequencer will advance to next Master step
+        if (++countRepeats > getRepeats()) {  // the Master sequencer will advance to next Master step
             repeatState = REPEATSTATE::COMPLETE;
         }
     }
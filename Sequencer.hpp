@@ -10,17 +10,24 @@ namespace CLC_Synths {
 		STILLHIGH,  // high as long as beat voltage is HIGH, and this will be across > 1 controller loops
 	};
 	class Sequencer { 
+	public:
+		static const int MAX_BARS = 16;
 	private:
 		// inputs
 		int beatsPerBar;
 		int bars;
+		int barsOffset;  // Bars CV, added to bars from the next reset() on
 
 		// state
 		int beatCount;
+		int playBars;    // bars the running count lasts
 		int targetBeats; // calculated
 		SEQRESET resetStatus;
 		BEATSTATE beatState;  // controlled by the Module based on voltage changes on the beat input
 
+		// methods
+		int nextPlayBars() const;
+
 	public:
 
 		// methods
@@ -33,18 +40,23 @@ namespace CLC_Synths {
 		SEQRESET getResetStatus() const { return resetStatus; };
 		void set_beatsPerBar(int b_beatsPerBar);
 		void set_bars(int p_bars);
+		void set_barsOffset(int p_barsOffset) { barsOffset = p_barsOffset; }
 		void set_beatState(BEATSTATE p_beatState) { beatState = p_beatState;}
 		
 		int getbeatsPerBar() const { return beatsPerBar; };
 		int getbars() const { return bars; };
+		int getplayBars() const { return playBars; };
 		int getbeatCount() const { return beatCount; };
 		int gettargetBeats() const { return targetBeats; };
+		int getnextTargetBeats() const;
 		BEATSTATE getbeatState() const { return beatState; };
+		bool isConsistent() const;
 		
 	};
 	Sequencer::Sequencer() {
 		beatsPerBar = 4;
 		bars = 1;
+		barsOffset = 0;
 		resetStatus = SEQRESET::NORESET;
 		calcTargetBeats();
 		reset();
@@ -52,12 +64,24 @@ namespace CLC_Synths {
 	Sequencer::Sequencer(int p_beatsPerBar, int p_bars) {
 		beatsPerBar = p_beatsPerBar;
 		bars = p_bars;
+		barsOffset = 0;
 		resetStatus = SEQRESET::NORESET;
 		calcTargetBeats();
 		reset();
 	}
 	void Sequencer::calcTargetBeats() {
-		targetBeats = beatsPerBar * bars;
+		// Bars CV only takes effect here, so a count never changes length part way through
+		playBars = nextPlayBars();
+		targetBeats = beatsPerBar * playBars;
+	}
+	int Sequencer::nextPlayBars() const {
+		// bars with the Bars CV added, clamped to 1..MAX_BARS; the one place the two are combined
+		int nextBars = bars + barsOffset;
+		return (nextBars < 1) ? 1 : (nextBars > MAX_BARS) ? MAX_BARS : nextBars;
+	}
+	int Sequencer::getnextTargetBeats() const {
+		// targetBeats as the next reset() will set it, the Bars CV included
+		return beatsPerBar * nextPlayBars();
 	}
 	void Sequencer::setReset() {
 		resetStatus = SEQRESET::RESET;
@@ -72,6 +96,12 @@ namespace CLC_Synths {
 		if (beatCount >= targetBeats)
 			resetStatus = SEQRESET::RESET;
 	}
+	bool Sequencer::isConsistent() const {
+		// a count that has reached its target always has a reset pending
+		if ((beatCount < 0) || (targetBeats != beatsPerBar * playBars))
+			return false;
+		return ((beatCount < targetBeats) || (resetStatus == SEQRESET::RESET));
+	}
 	void Sequencer::set_beatsPerBar(int p_beatsPerBar) {
 		if (beatsPerBar == p_beatsPerBar)
 			return;
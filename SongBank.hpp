@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include "HighSeqModule.hpp"
+
+namespace CLC_Synths {
+
+	// One song of the bank, kept as the values the modules take so loading it is a handful of stores per step.
+	// Written and read on the audio thread only: a store lands at the start of a block, and a lane playing
+	// the song takes the new values at its next step boundary
+	struct StoredSong {
+		static const int MAX_LANES = 4;
+		bool stored;                                                // empty slots play the parameters
+		int8_t beatsPerBar[HighSeqModule::NUM_SEQUENCERS];
+		int8_t bars[HighSeqModule::NUM_SEQUENCERS];
+		int8_t selectValue[HighSeqModule::NUM_SEQUENCERS];          // St.Seq. sequence 1..32
+		int8_t stepSeq[MAX_LANES][HighSeqModule::NUM_STEPS];
+		int8_t stepRepeats[MAX_LANES][HighSeqModule::NUM_STEPS];
+		int8_t stepSwitch[MAX_LANES][HighSeqModule::NUM_STEPS];
+
+		void load(HighSeqModule& module, int lane) const;
+		bool loadedIn(const HighSeqModule& module, int lane) const;
+	};
+
+	void StoredSong::load(HighSeqModule& module, int lane) const {
+		// at a step boundary: the lane's grid and the sequencers' counts. Beats per bar and bars that change
+		// restart their sequencer, as an edit would
+		for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++) {
+			module.sequencers[s].set_beatsPerBar(beatsPerBar[s]);
+			module.sequencers[s].set_bars(bars[s]);
+		}
+		for (int i = 0; i < HighSeqModule::NUM_STEPS; i++) {
+			module.steps[i].set_sequencer(stepSeq[lane][i]);
+			module.steps[i].set_repeats(stepRepeats[lane][i]);
+			module.steps[i].set_switch(static_cast<SWITCHSTATE>(stepSwitch[lane][i]));
+		}
+		module.refreshOrder();   // the boundary carries on in the new song's order
+	}
+
+	bool StoredSong::loadedIn(const HighSeqModule& module, int lane) const {
+		// the module holds this song's values, as load() left them
+		for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++) {
+			if ((module.sequencers[s].getbeatsPerBar() != beatsPerBar[s]) || (module.sequencers[s].getbars() != bars[s]))
+				return false;
+		}
+		for (int i = 0; i < HighSeqModule::NUM_STEPS; i++) {
+			const MasterStep& step = module.steps[i];
+			if ((step.getAssignedSeq() != stepSeq[lane][i]) || (step.getRepeats(0) != stepRepeats[lane][i]) ||
+				(step.getOnOffSwitch() != static_cast<SWITCHSTATE>(stepSwitch[lane][i])))
+				return false;
+		}
+		return true;
+	}
+} // namespace
@@ -0,0 +1,190 @@
+#pragma once
+#include <stdint.h>
+
+namespace CLC_Synths {
+
+	// Values of an Arrangement parameter, the source of one program instruction
+	enum PROGRAMSOURCE {
+		SOURCE_EMPTY = 0,       // skipped
+		SOURCE_STEP1 = 1,       // 1..8: play step 1..8 (its repeats included)
+		SOURCE_LOOP = 9,        // start of a loop body
+		SOURCE_NEXT2 = 10,      // 10..16: back to the matching Loop until the body has played 2..8 times
+		SOURCE_GOTO1 = 17,      // 17..28: carry on from instruction 1..12, leaving any loops
+		SOURCE_END = 29,        // the song stops here until the next reset
+	};
+
+	// Compiled instructions: opcode in the high nibble, argument in the low one
+	enum PROGRAMOP {
+		OP_STEP = 0,            // argument: step 0..7
+		OP_LOOP,                // argument: times the body plays
+		OP_NEXT,                // argument: pc of the loop body
+		OP_GOTO,                // argument: pc to carry on from
+		OP_END,
+	};
+
+	// Where a lane is in the program. Only touched at step boundaries
+	struct ProgramCursor {
+		static const int MAX_LOOP_DEPTH = 4;
+		uint8_t pc;
+		uint8_t depth;
+		uint8_t remaining[MAX_LOOP_DEPTH];   // plays of each open loop body still to come
+		bool passStart;                      // the step last returned began a pass through the program
+		ProgramCursor() : pc(0), depth(0), passStart(false) {}
+	};
+
+	// An arrangement as a tiny program: steps to play, nested loops, gotos and an end. Compiled from the
+	// Arrangement parameters off the audio thread; next() runs it to the next step to play
+	class SongProgram {
+	public:
+		static const int MAX_INSTRUCTIONS = 12;
+		static const int MAX_EXECUTED = 256;    // instructions one next() may run before giving up on finding a step
+	private:
+		uint8_t code[MAX_INSTRUCTIONS];
+		uint8_t length;
+		uint8_t reach[MAX_INSTRUCTIONS];        // bit per step a cursor at each pc can get to, so next() can skip a hopeless search
+	public:
+		SongProgram() : length(0) {}
+		int compile(const int16_t* source, int count);
+		int size() const { return length; }
+		int next(ProgramCursor& cursor, unsigned switchMask) const;
+	};
+
+	int SongProgram::compile(const int16_t* source, int count) {
+		// returns the instructions dropped: Loop and Next that do not pair up. Loops nested deeper than
+		// MAX_LOOP_DEPTH reject the whole program, which then plays nothing and counts every instruction dropped
+		int partner[MAX_INSTRUCTIONS];
+		int open[ProgramCursor::MAX_LOOP_DEPTH];
+		int depth = 0;
+		int dropped = 0;
+		if (count > MAX_INSTRUCTIONS)
+			count = MAX_INSTRUCTIONS;
+		length = 0;
+		for (int i = 0; i < count; i++) {
+			partner[i] = -1;
+			if (source[i] == SOURCE_LOOP) {
+				if (depth == ProgramCursor::MAX_LOOP_DEPTH) {
+					for (int j = 0; j < count; j++)
+						dropped += (source[j] != SOURCE_EMPTY);
+					return dropped;
+				}
+				open[depth++] = i;
+			} else if (source[i] >= SOURCE_NEXT2 && source[i] < SOURCE_GOTO1 && depth > 0) {
+				partner[i] = open[--depth];
+				partner[partner[i]] = i;
+			}
+		}
+
+		// pc of each source instruction; a goto to an empty or dropped one lands on the next kept
+		uint8_t pcOf[MAX_INSTRUCTIONS + 1];
+		uint8_t sourceOf[MAX_INSTRUCTIONS];
+		for (int i = 0; i < count; i++) {
+			pcOf[i] = length;
+			int value = source[i];
+			if (value == SOURCE_EMPTY)
+				continue;
+			if ((value == SOURCE_LOOP || (value >= SOURCE_NEXT2 && value < SOURCE_GOTO1)) && partner[i] == -1) {
+				dropped++;
+				continue;
+			}
+			sourceOf[length++] = i;
+		}
+		pcOf[count] = length;
+
+		for (int pc = 0; pc < length; pc++) {
+			int i = sourceOf[pc];
+			int value = source[i];
+			if (value < SOURCE_LOOP) {
+				code[pc] = (OP_STEP << 4) | (value - SOURCE_STEP1);
+			}
+			else if (value == SOURCE_LOOP)
+				code[pc] = (OP_LOOP << 4) | (source[partner[i]] - SOURCE_NEXT2 + 2);
+			else if (value < SOURCE_GOTO1)
+				code[pc] = (OP_NEXT << 4) | (pcOf[partner[i]] + 1);
+			else if (value < SOURCE_END)
+				code[pc] = (OP_GOTO << 4) | pcOf[(value - SOURCE_GOTO1 < count) ? value - SOURCE_GOTO1 : count];
+			else
+				code[pc] = (OP_END << 4);
+		}
+
+		// the steps each pc leads to, whatever the loops count: a Next may go back or on, and running off the
+		// end starts over. Edits keep the cursor where it was, so every pc gets its own set
+		for (int start = 0; start < length; start++) {
+			unsigned seen = 1u << start;
+			int pending[MAX_INSTRUCTIONS];
+			int waiting = 0;
+			pending[waiting++] = start;
+			reach[start] = 0;
+			while (waiting > 0) {
+				int pc = pending[--waiting];
+				int op = code[pc] >> 4;
+				int argument = code[pc] & 0x0F;
+				int to[2] = { pc + 1, -1 };
+				if (op == OP_STEP)
+					reach[start] |= 1u << argument;
+				else if (op == OP_NEXT)
+					to[1] = argument;
+				else if (op == OP_GOTO)
+					to[0] = argument;
+				else if (op == OP_END)
+					to[0] = -1;
+				for (int t = 0; t < 2; t++) {
+					int target = (to[t] >= length) ? 0 : to[t];
+					if ((to[t] >= 0) && !(seen & (1u << target))) {
+						seen |= 1u << target;
+						pending[waiting++] = target;
+					}
+				}
+			}
+		}
+		return dropped;
+	}
+
+	int SongProgram::next(ProgramCursor& cursor, unsigned switchMask) const {
+		// the next step to play that is switched on, moving the cursor past it; -1 at an End, for an empty
+		// program, or when MAX_EXECUTED instructions find no step to play. Running off the end starts over
+		bool passStart = false;
+		if ((length == 0) || ((reach[(cursor.pc < length) ? cursor.pc : 0] & switchMask) == 0))
+			return -1;   // every step it can get to is off: the search below could only run out
+		for (int executed = 0; (executed < MAX_EXECUTED) && (length > 0); executed++) {
+			if (cursor.pc >= length) {
+				cursor.pc = 0;
+				cursor.depth = 0;
+			}
+			if (cursor.pc == 0)
+				passStart = true;
+			int op = code[cursor.pc] >> 4;
+			int argument = code[cursor.pc] & 0x0F;
+			switch (op) {
+				case OP_STEP:
+					cursor.pc++;
+					if (switchMask & (1u << argument)) {
+						cursor.passStart = passStart;
+						return argument;
+					}
+					break;
+				case OP_LOOP:
+					if (cursor.depth < ProgramCursor::MAX_LOOP_DEPTH)
+						cursor.remaining[cursor.depth++] = argument - 1;
+					cursor.pc++;
+					break;
+				case OP_NEXT:
+					if ((cursor.depth > 0) && (cursor.remaining[cursor.depth - 1] > 0)) {
+						cursor.remaining[cursor.depth - 1]--;
+						cursor.pc = argument;
+					} else {
+						if (cursor.depth > 0)
+							cursor.depth--;
+						cursor.pc++;
+					}
+					break;
+				case OP_GOTO:
+					cursor.pc = argument;
+					cursor.depth = 0;
+					break;
+				default:
+					return -1;   // End: stays put until the cursor is reset
+			}
+		}
+		return -1;
+	}
+} // namespace
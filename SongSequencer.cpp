@@ -5,6 +5,11 @@
 #include "HighSeqModule.hpp"
 #include "MasterStep.hpp"
 #include "Sequencer.hpp"
+#include "SongBank.hpp"
+#include "SongProgram.hpp"
+#include "StepOrder.hpp"
+#include "StateSnapshot.hpp"
+#include "TraceBuffer.hpp"
 
 using namespace CLC_Synths;
 
@@ -20,10 +25,118 @@ struct _cell {
     _cell () : row(1), col(1) {}
 };
 
+static const int MAX_LANES = 4;
+static const int MAX_SONGS = 16;
+static const int MAX_VOICES = 8;
+
+static_assert(StoredSong::MAX_LANES == MAX_LANES, "a bank song holds every lane's grid");
+
+// One song lane: its own step grid, sequencing state and master outputs.
+// Lanes share the sequencer inputs A..H, their Bars/Beats per Bar, and the beat/reset decode.
+struct SongLane {
+    HighSeqModule highSeqModule;
+
+    int pitchBusOUT;            // master outputs for this lane (-1 = unassigned)
+    int gateBusOUT;
+    int assignableBusOUT;
+    int stepRampBusOUT;         // position outputs (-1 = unassigned)
+    int songRampBusOUT;
+    int stepCVBusOUT;
+    int endGateBusOUT;
+
+    int song;                   // bank song playing, 0 = the parameters
+    const StoredSong* storedSong;   // that song, nullptr while playing the parameters
+    int8_t selectValue[HighSeqModule::NUM_SEQUENCERS];  // its St.Seq. sequences, as loaded
+    bool songStale;             // Store Song wrote over the song playing; it is loaded again at the next step boundary
+    int jumpStep;               // step a Jump trigger asked for, waiting on its beat or bar; -1 = none
+
+    const float* quantizeTable; // nearest note per half semitone bin for the lane's scale and root, nullptr = off
+
+    bool triggerActive;
+    int triggerFrameCounter;
+    bool triggerHandled;
+    bool triggerPredicted;      // reset trigger already started ahead of the beat that ends the sequence
+
+    float selectorVoltsOut;
+
+    // for renderPosition(), kept by cacheSongPosition()
+    int songBeats;              // module.songLength(), when the parameters, the modulation or the song change
+    bool endsPass;              // module.nextStartsPass(), at every step boundary too
+
+    uint32_t passBeats;         // Song Ramp: beats so far in this pass, a pass starting each time the song comes round
+
+    StateSnapshot snapshot;     // written by step(), read by draw()
+};
+
+// A frame in the block where the beat or reset input needs per frame handling
+struct SongEvent {
+    uint16_t frame;
+    uint8_t flags;              // SONGEVENT flags
+    int8_t step;                // sync entries only: the leader's master step after this frame
+    uint8_t beats;              // one bit per sequencer with a rising edge on its beat, own input or shared
+};
+
+enum SONGEVENT {
+    EVENT_BEAT = 1,             // rising edge on the beat input
+    EVENT_RESET = 2,            // reset input high
+    EVENT_JUMP = 4,             // rising edge on the Jump Trigger input
+};
+
+// Beat period estimate from the frames between beat edges
+struct BeatTracker {
+    int lastBeatFrame;          // frame of the last beat edge relative to this block (negative = earlier block), NO_BEAT if none
+    int lastPeriod;             // frames between the last two beat edges, 0 until known
+    int smoothedPeriod;         // running average of lastPeriod in 1/16 frames, 0 until known
+    int stableBeats;            // beats in a row within tolerance of the average
+};
+
+enum UIPAGE {
+    UIPAGE_GRID = 0,
+    UIPAGE_DIAGNOSTICS,
+    UIPAGE_TRACE,
+};
+
+enum CLOCKSOURCE {
+    CLOCK_BEAT_INPUT = 0,
+    CLOCK_INTERNAL,             // beats from the tempo phase accumulator, the Beat input is ignored
+};
+
+enum JUMPQUANTIZE {
+    JUMP_IMMEDIATE = 0,         // on the trigger frame
+    JUMP_BEAT,                  // on the running sequencer's next beat
+    JUMP_BAR,                   // on the running sequencer's next beat that starts a bar
+};
+
+enum SYNCMODE {
+    SYNC_OFF = 0,
+    SYNC_LEADER,                // publishes its beat/reset events and lane 1 steps to its sync group
+    SYNC_FOLLOWER,              // takes events and steps from its group's leader instead of the beat input
+};
+
+// Published by a leader once per block, read by its followers later in the same block
+struct SyncSlot {
+    volatile uint32_t publishCount;   // bumped after each block's entries are complete
+    int numEntries;
+    SongEvent* entries;               // maxFramesPerStep entries in static memory
+};
+
 struct SongSequencer : public _NT_algorithm {
     SongSequencer() {}
     ~SongSequencer() {}
-    HighSeqModule highSeqModule;
+
+    int numLanes;
+    int voices;                 // buses in each pitch, gate and assignable group
+    SongLane* lanes;            // numLanes lanes, allocated in SRAM after this struct
+    SongEvent* events;          // this block's beat/reset events, shared by all lanes
+    int maxEvents;
+    uint32_t beatLevels;        // BEAT_LANE bits high on the last frame of the previous block
+    uint32_t clockPhase;        // internal clock: beat starts when it wraps, high for the first half
+    uint32_t clockIncrement;    // phase per frame at this block's tempo, 0 = clocked by the Beat input
+    uint32_t syncPublishSeen;   // follower: the leader publish last consumed
+    int leaderStep;             // follower: the leader's master step as of the last frame processed
+    int repeatOffset;           // modulation as read last block, so lanes recache only when it moves
+    int barsOffset;
+    unsigned stepMask;
 
     int sequencerCVInput[HighSeqModule::NUM_SEQUENCERS];      // CV input bus index for each sequencer (-1 = unassigned)
     int sequencerGateInput[HighSeqModule::NUM_SEQUENCERS];    // Gate input bus index for each sequencer (-1 = unassigned)
@@ -31,20 +144,59 @@ struct SongSequencer : public _NT_algorithm {
     int sequencerSelectOutput[HighSeqModule::NUM_SEQUENCERS];    // NT Step Sequencer Select for each sequencer (-1 = unassigned)
     int sequencerTransposeInput[HighSeqModule::NUM_SEQUENCERS];    // Transpose input bus index for each sequencer (-1 = unassigned)
     int sequencerCVAssignableInput[HighSeqModule::NUM_SEQUENCERS];    // Assignable CV input bus for each sequencer (-1 = unassigned)
+    int sequencerBeatInput[HighSeqModule::NUM_SEQUENCERS];    // Own beat input bus for each sequencer (-1 = the shared Beat input)
     bool editMode;
-
-    bool triggerActive;
-    int triggerFrameCounter;
-    bool triggerHandled;
-    float SAMPLE_RATE = 48000;
-    float FRAME_TIME_MS = (1.f/SAMPLE_RATE) * 1000.f;
-    float TRIGGER_FRAME_TARGET_MS = 25.0f;
-    float TRIGGER_FRAMES_NEEDED = TRIGGER_FRAME_TARGET_MS / FRAME_TIME_MS;
+    int uiLane;                 // lane shown and edited by the custom UI
+    int uiPage;                 // UIPAGE shown by the custom UI
+    int traceScroll;            // trace page: records back from the newest
+    volatile bool parametersDirty;  // set by parameterChanged(), cleared by step()
+    volatile int lastEditedParam;   // last parameter parameterChanged() saw, traced by step()
+
+    TraceBuffer trace;          // records in DRAM, empty unless the Trace specification is set
+    StoredSong* songs;          // bank in DRAM after the trace records, numSongs long; audio thread only
+    std::atomic<uint32_t> storeRequests;    // bit per bank song Store Song asked for, stored by the next step()
+    int numSongs;
+    int requestedSong;          // song lanes change to at their next step boundary, 0 = the parameters
+    SongProgram* pendingProgram;    // the Arrangement as parameterChanged() last compiled it, in DRAM after the bank
+    volatile uint32_t pendingVersion;   // odd while parameterChanged() compiles into pendingProgram
+    SongProgram* program;       // step()'s copy of it, the one lanes play, in DRAM after pendingProgram
+    uint32_t programVersion;    // pendingVersion that copy was taken at, step() only
+    int programDropped;         // Arrangement instructions left out of the last compile
+    bool resetWasHigh;          // reset input on the last frame, so a held reset is traced once
+
+    int triggerFramesNeeded;    // reset trigger length in frames, from the shared table for the current sample rate
+
+    BeatTracker beat;
+    int selectLead;             // frames before the predicted step change to send the next St.Seq. select, 0 = off
+    int resetLead;              // frames before the predicted beat to start a reset trigger, 0 = on the beat
 
     bool resetdebug;
     bool resetdebugever;
 
-    float selectorVoltsOut;
+    uint32_t blockCount;        // audio blocks processed, published with the snapshot
+    uint32_t steadyBlocks;      // blocks rendered without any per frame processing
+#ifdef SONGSEQ_DEBUG
+    uint32_t faultBlocks;       // blocks that ended with HighSeqModule::checkInvariants() failing on a lane
+    int faultMask;              // INVARIANT bits of every failure so far
+#endif
+#ifdef SONGSEQ_PROFILE
+    uint32_t windowCycles;      // cycles spent in step() so far in the current measuring window
+    uint32_t windowFrames;
+    int windowBlocks;
+    uint32_t blockCycles;       // average cycles per block over the last complete window
+    uint32_t frameCycles;       // the same per frame, so instances on different block sizes compare
+    uint32_t peakCycles;        // most cycles any one block took
+    int peakFrames;             // frames in that block
+    uint32_t peakFrameCycles;   // most cycles per frame of any block
+#endif
+    uint32_t stepLatency[LATENCY_BUCKETS];   // frames from the beat edge to the first frame played from the new step
+    uint32_t resetLatency[LATENCY_BUCKETS];  // frames from the beat edge to the start of its reset trigger
+    int seqBeatFrame[HighSeqModule::NUM_SEQUENCERS];    // each sequencer's last beat edge, own or shared input, as lastBeatFrame
+    uint32_t sramBytes;         // this instance's memory, as granted by calculateRequirements
+    uint32_t dramBytes;
+    SongState displayState;     // last snapshot successfully read by draw()
+
+    _NT_parameterPages parameterPagesStruct;  // fixed pages plus one page per extra lane
 
 //    _NT_uiData lastUiData; // Store last UI data for debugging
 
@@ -53,10 +205,68 @@ struct SongSequencer : public _NT_algorithm {
     _cell cell;
 };
 
+// Fields of one sequencer's Seq Assign parameters, of one sequencer's Seq Config parameters and of one
+// step's Step Config parameters. The parameter indices, rows and pages below all come from these
+enum {
+    kSeqParamCVInput,
+    kSeqParamGateInput,
+    kSeqParamResetOutput,
+    kSeqParamSelectOutput,
+    kSeqParamSelectValue,
+    kSeqParamTransposeInput,
+    kSeqParamAssignableCVInput,
+    kNumSeqRoutingParams
+};
+enum {
+    kSeqParamBeatsPerBar,
+    kSeqParamBars,
+    kNumSeqConfigParams
+};
+enum {
+    kStepParamSeq,
+    kStepParamRepeats,
+    kStepParamSwitch,
+    kNumStepParams
+};
+
 // constants
-static const int PARAMS_PER_SEQUENCER = 2;
-static const int PARAMS_PER_MASTERSTEP = 3;
+static const int NUM_BUSES = 28;
+static const int NUM_SYNC_GROUPS = 4;
 static const float SEQ12THV = 1.f/12.f;  // 1 12th of a volt to provide volts per octave note increments
+static const float TRIGGER_FRAME_TARGET_MS = 25.0f;
+static const int NUM_ST_SEQUENCES = 32;   // sequences selectable in the NT Step Sequencer
+static const int MAX_DIGIT_STRING = 256;  // 16 bars * 16 beats per bar is the largest number the UI shows
+static const uint32_t knownSampleRates[] = { 44100, 48000, 88200, 96000 };
+static const int NO_BEAT = -(1 << 30);
+static const int MAX_BEAT_PERIOD = 1 << 20;     // frames; ~11 s at 96kHz, slower than that counts as stopped
+static const int BEAT_PERIOD_SHIFT = 4;         // smoothed period is kept in 1/16 frames
+static const int BEAT_SMOOTHING_SHIFT = 2;      // each beat moves the average 1/4 of the way
+static const int BEAT_TOLERANCE_SHIFT = 3;      // a beat within 1/8 of the average is on time
+static const int MIN_STABLE_BEATS = 4;          // on time beats in a row before the period is trusted for predictions
+static const int MAX_RESET_LEAD_MS = 20;
+static const int MIN_TEMPO = 20;               // BPM; the Tempo CV input may take it outside this
+static const int MAX_TEMPO = 300;
+static const float MIN_MODULATED_TEMPO = 1.f;
+static const float MAX_MODULATED_TEMPO = 1000.f;
+static const float PHASE_PER_CYCLE = 4294967296.f;   // 2^32: one beat is one wrap of the 32 bit phase
+static const int BEAT_LANE_SHARED = 8;          // beat lanes 0..7 are the sequencers, this one the Beat input
+static const int BEAT_LANE_JUMP = 9;            // edges of the Jump Trigger input, decoded with the beats
+static const int BEAT_GROUP_FRAMES = 4;         // frames decoded together, one 16 bit lane field each
+static const uint64_t BEAT_FRAME_REPEAT = 0x0001000100010001ull;   // copies a lane mask into every frame field
+static const int TRACE_RECORDS_PER_UNIT = 256;  // the Trace specification counts in these
+static const int MAX_TRACE_UNITS = 64;
+static const int TRACE_PAGE_LINES = 7;
+#ifdef SONGSEQ_PROFILE
+static const int CYCLE_WINDOW_BLOCKS = 256;     // blocks averaged into each cycle figure
+#endif
+static const char* const latencyLabels[LATENCY_BUCKETS] = { "-", "0", "1", "2", "3", "4", "8", "16" };
+static const int MAX_SELECT_LEAD_FRAMES = 4800;
+static const int MAX_ORDER_SEED = 999;            // Random Step Order: each seed plays its own shuffles
+static const float MAX_MODULATION = 16.f;         // volts the Repeats and Bars CV inputs count up to, either way
+static const float STEP_MASKS_PER_VOLT = 25.5f;   // 10V = mask 255, every step
+static const int SEMITONES = 12;
+static const int QUANTIZE_BINS = 2 * SEMITONES;  // half semitone bins: the midpoint between two notes is always on a bin edge
+static const float QUANTIZE_RANGE = 16.f;        // volts either side of 0 the quantizer handles; also the octave bias that keeps bins positive
 
 // Parameter indices
 enum {
@@ -66,133 +276,228 @@ enum {
     kParamGateOutput,
     kParamAssignableOutput,
 
+    // Seq Assign, Seq Config and Step Config blocks, one field enum per sequencer or step;
+    // seqRoutingParam(), seqConfigParam() and stepParam() index into them
     kParamSeq1CVInput,
-    kParamSeq1GateInput,
-    kParamSeq1ResetOutput,
-    kParamSeq1SeqSelectOutput,
-    kParamSeq1SeqSelectValue,
-    kParamSeq1TransposeInput,
-    kParamSeq1AssignableCVInput,
-
-    kParamSeq2CVInput,
-    kParamSeq2GateInput,
-    kParamSeq2ResetOutput,
-    kParamSeq2SeqSelectOutput,
-    kParamSeq2SeqSelectValue,
-    kParamSeq2TransposeInput,
-    kParamSeq2AssignableCVInput,
-
-    kParamSeq3CVInput,
-    kParamSeq3GateInput,
-    kParamSeq3ResetOutput,
-    kParamSeq3SeqSelectOutput,
-    kParamSeq3SeqSelectValue,
-    kParamSeq3TransposeInput,
-    kParamSeq3AssignableCVInput,
-
-    kParamSeq4CVInput,
-    kParamSeq4GateInput,
-    kParamSeq4ResetOutput,
-    kParamSeq4SeqSelectOutput,
-    kParamSeq4SeqSelectValue,
-    kParamSeq4TransposeInput,
-    kParamSeq4AssignableCVInput,
-
-    kParamSeq5CVInput,
-    kParamSeq5GateInput,
-    kParamSeq5ResetOutput,
-    kParamSeq5SeqSelectOutput,
-    kParamSeq5SeqSelectValue,
-    kParamSeq5TransposeInput,
-    kParamSeq5AssignableCVInput,
-
-    kParamSeq6CVInput,
-    kParamSeq6GateInput,
-    kParamSeq6ResetOutput,
-    kParamSeq6SeqSelectOutput,
-    kParamSeq6SeqSelectValue,
-    kParamSeq6TransposeInput,
-    kParamSeq6AssignableCVInput,
-
-    kParamSeq7CVInput,
-    kParamSeq7GateInput,
-    kParamSeq7ResetOutput,
-    kParamSeq7SeqSelectOutput,
-    kParamSeq7SeqSelectValue,
-    kParamSeq7TransposeInput,
-    kParamSeq7AssignableCVInput,
-
-    kParamSeq8CVInput,
-    kParamSeq8GateInput,
-    kParamSeq8ResetOutput,
-    kParamSeq8SeqSelectOutput,
-    kParamSeq8SeqSelectValue,
-    kParamSeq8TransposeInput,
-    kParamSeq8AssignableCVInput,
-
-    kParamSeq1BeatsPerBar,
-    kParamSeq1Bars,
-
-    kParamSeq2BeatsPerBar,
-    kParamSeq2Bars,
-
-    kParamSeq3BeatsPerBar,
-    kParamSeq3Bars,
-
-    kParamSeq4BeatsPerBar,
-    kParamSeq4Bars,
-
-    kParamSeq5BeatsPerBar,
-    kParamSeq5Bars,
-
-    kParamSeq6BeatsPerBar,
-    kParamSeq6Bars,
-
-    kParamSeq7BeatsPerBar,
-    kParamSeq7Bars,
-
-    kParamSeq8BeatsPerBar,
-    kParamSeq8Bars,
-
-    kParamStep1Seq,
-    kParamStep1Repeats,
-    kParamStep1Switch,
-
-    kParamStep2Seq,
-    kParamStep2Repeats,
-    kParamStep2Switch,
-
-    kParamStep3Seq,
-    kParamStep3Repeats,
-    kParamStep3Switch,
-
-    kParamStep4Seq,
-    kParamStep4Repeats,
-    kParamStep4Switch,
-
-    kParamStep5Seq,
-    kParamStep5Repeats,
-    kParamStep5Switch,
-
-    kParamStep6Seq,
-    kParamStep6Repeats,
-    kParamStep6Switch,
-
-    kParamStep7Seq,
-    kParamStep7Repeats,
-    kParamStep7Switch,
-
-    kParamStep8Seq,
-    kParamStep8Repeats,
-    kParamStep8Switch
+    kParamSeq1BeatsPerBar = kParamSeq1CVInput + HighSeqModule::NUM_SEQUENCERS * kNumSeqRoutingParams,
+    kParamStep1Seq = kParamSeq1BeatsPerBar + HighSeqModule::NUM_SEQUENCERS * kNumSeqConfigParams,
+    kParamSyncMode = kParamStep1Seq + HighSeqModule::NUM_STEPS * kNumStepParams,
+    kParamSyncGroup,
+
+    kParamQuantizeScale,
+    kParamQuantizeRoot,
+
+    kParamSelectLeadFrames,
+    kParamSelectLeadPercent,
+    kParamResetLead,
+
+    kParamSeq1BeatInput,        // Seq1..Seq8 follow each other
+    kParamSeq8BeatInput = kParamSeq1BeatInput + HighSeqModule::NUM_SEQUENCERS - 1,
+
+    kParamClockSource,
+    kParamTempo,
+    kParamTempoCVInput,
+    kParamClockOutput,
+
+    kParamStepRampOutput,
+    kParamSongRampOutput,
+    kParamStepCVOutput,
+    kParamEndGateOutput,
+
+    kParamSong,
+    kParamSongCVInput,
+    kParamSongMidiChannel,
+    kParamStoreSong,
+
+    kParamJumpCVInput,
+    kParamJumpTriggerInput,
+    kParamJumpQuantize,
+
+    kParamStepOrder,
+    kParamOrderSeed,
+
+    kParamRepeatsCVInput,
+    kParamBarsCVInput,
+    kParamStepMaskCVInput,
+
+    kParamArrangement1,         // Arrangement 1..12 follow each other
+    kParamArrangement12 = kParamArrangement1 + SongProgram::MAX_INSTRUCTIONS - 1,
+
+    kParamLane2Base     // lanes 2..MAX_LANES follow in blocks of kNumLaneParams
 };
 
+// Parameter layout of one lane. Lane 1 uses the Routing and Step Config parameters above
+enum {
+    kLaneParamPitchCVOutput,
+    kLaneParamGateOutput,
+    kLaneParamAssignableOutput,
+    kLaneParamQuantizeScale,
+    kLaneParamQuantizeRoot,
+    kLaneParamStepRampOutput,
+    kLaneParamSongRampOutput,
+    kLaneParamStepCVOutput,
+    kLaneParamEndGateOutput,
+    kLaneParamStep1Seq,
+    kLaneParamStep1Repeats,
+    kLaneParamStep1Switch,
+
+    kNumLaneParams = kLaneParamStep1Seq + HighSeqModule::NUM_STEPS * kNumStepParams
+};
+
+constexpr int seqRoutingParam (int sequencer, int field) {
+    // global index of a sequencer's Seq Assign parameter
+    return kParamSeq1CVInput + sequencer * kNumSeqRoutingParams + field;
+}
+
+constexpr int seqConfigParam (int sequencer, int field) {
+    return kParamSeq1BeatsPerBar + sequencer * kNumSeqConfigParams + field;
+}
+
+constexpr int stepParam (int step, int field) {
+    // lane 1's Step Config parameter; other lanes through laneParam()
+    return kParamStep1Seq + step * kNumStepParams + field;
+}
+
+int laneParam (int lane, int field) {
+    // global parameter index of a lane field
+    if (lane > 0)
+        return kParamLane2Base + (lane - 1) * kNumLaneParams + field;
+    switch (field) {
+        case kLaneParamPitchCVOutput: return kParamPitchCVOutput;
+        case kLaneParamGateOutput: return kParamGateOutput;
+        case kLaneParamAssignableOutput: return kParamAssignableOutput;
+        case kLaneParamQuantizeScale: return kParamQuantizeScale;
+        case kLaneParamQuantizeRoot: return kParamQuantizeRoot;
+        case kLaneParamStepRampOutput: return kParamStepRampOutput;
+        case kLaneParamSongRampOutput: return kParamSongRampOutput;
+        case kLaneParamStepCVOutput: return kParamStepCVOutput;
+        case kLaneParamEndGateOutput: return kParamEndGateOutput;
+        default: return kParamStep1Seq + (field - kLaneParamStep1Seq);
+    }
+}
+
+int numParametersForLanes (int lanes) {
+    return kParamLane2Base + (lanes - 1) * kNumLaneParams;
+}
+
 static const char* const enumStringsSwitch[] = {
     "Off",
     "On",
     nullptr
 };
 
+static const char* const enumStringsClock[] = {
+    "Beat Input",
+    "Internal",
+    nullptr
+};
+
+static const char* const enumStringsJump[] = {
+    "Immediate",
+    "Next Beat",
+    "Next Bar",
+    nullptr
+};
+
+static const char* const enumStringsStepOrder[] = {
+    "Forward",
+    "Reverse",
+    "Ping-Pong",
+    "Random",
+    nullptr
+};
+
+// Arrangement instructions, in PROGRAMSOURCE order
+static const char* const enumStringsArrangement[] = {
+    "-",
+    "Step 1",
+    "Step 2",
+    "Step 3",
+    "Step 4",
+    "Step 5",
+    "Step 6",
+    "Step 7",
+    "Step 8",
+    "Loop",
+    "Next x2",
+    "Next x3",
+    "Next x4",
+    "Next x5",
+    "Next x6",
+    "Next x7",
+    "Next x8",
+    "Goto 1",
+    "Goto 2",
+    "Goto 3",
+    "Goto 4",
+    "Goto 5",
+    "Goto 6",
+    "Goto 7",
+    "Goto 8",
+    "Goto 9",
+    "Goto 10",
+    "Goto 11",
+    "Goto 12",
+    "End",
+    nullptr
+};
+static_assert(ARRAY_SIZE(enumStringsArrangement) == SOURCE_END + 2, "one name per PROGRAMSOURCE value, plus the terminator");
+
+static const char* const enumStringsSync[] = {
+    "Off",
+    "Leader",
+    "Follower",
+    nullptr
+};
+
+// Quantizer scales; "Off" passes pitch + transpose through unquantized
+static const char* const enumStringsScale[] = {
+    "Off",
+    "Chromatic",
+    "Major",
+    "Minor",
+    "Harm Minor",
+    "Dorian",
+    "Mixolydian",
+    "Maj Penta",
+    "Min Penta",
+    "Blues",
+    "Whole Tone",
+    nullptr
+};
+
+// Notes of each scale above as a bit per semitone from the root, bit 0 = root
+static const uint16_t scaleMasks[] = {
+    0xFFF,                                                          // Chromatic
+    (1<<0) | (1<<2) | (1<<4) | (1<<5) | (1<<7) | (1<<9) | (1<<11),  // Major
+    (1<<0) | (1<<2) | (1<<3) | (1<<5) | (1<<7) | (1<<8) | (1<<10),  // Minor
+    (1<<0) | (1<<2) | (1<<3) | (1<<5) | (1<<7) | (1<<8) | (1<<11),  // Harm Minor
+    (1<<0) | (1<<2) | (1<<3) | (1<<5) | (1<<7) | (1<<9) | (1<<10),  // Dorian
+    (1<<0) | (1<<2) | (1<<4) | (1<<5) | (1<<7) | (1<<9) | (1<<10),  // Mixolydian
+    (1<<0) | (1<<2) | (1<<4) | (1<<7) | (1<<9),                     // Maj Penta
+    (1<<0) | (1<<3) | (1<<5) | (1<<7) | (1<<10),                    // Min Penta
+    (1<<0) | (1<<3) | (1<<5) | (1<<6) | (1<<7) | (1<<10),           // Blues
+    (1<<0) | (1<<2) | (1<<4) | (1<<6) | (1<<8) | (1<<10),           // Whole Tone
+};
+static const int NUM_SCALES = ARRAY_SIZE(scaleMasks);
+static_assert(ARRAY_SIZE(enumStringsScale) == NUM_SCALES + 2, "one scale name per mask, plus Off and the terminator");
+
+static const char* const enumStringsRoot[] = {
+    "C",
+    "C#",
+    "D",
+    "D#",
+    "E",
+    "F",
+    "F#",
+    "G",
+    "G#",
+    "A",
+    "A#",
+    "B",
+    nullptr
+};
+
 // Enum strings for Output Mode
 static const char* const enumStringsSequencers[] = {
     "A",
@@ -207,6 +512,106 @@ static const char* const enumStringsSequencers[] = {
 };
 
 
+// Sequencers A..H in order: index, letter, then the default CV, Gate and Reset buses. Every per sequencer
+// parameter row and page entry is generated from this list; X is one of the SEQUENCER_ macros below
+#define SEQUENCER_LIST(X) \
+    X(0, "A", 3, 4, 18) \
+    X(1, "B", 5, 6, 18) \
+    X(2, "C", 7, 8, 18) \
+    X(3, "D", 9, 10, 18) \
+    X(4, "E", 11, 12, 18) \
+    X(5, "F", 0, 0, 0) \
+    X(6, "G", 0, 0, 0) \
+    X(7, "H", 0, 0, 0)
+
+// rows in kSeqParam order
+#define SEQUENCER_ROUTING_PARAMETERS(s, seq, cv, gate, reset) \
+    NT_PARAMETER_CV_INPUT(seq " CV Input", 0, cv) \
+    NT_PARAMETER_CV_INPUT(seq " Gate Input", 0, gate) \
+    NT_PARAMETER_CV_INPUT(seq " Reset Output", 0, reset) \
+    NT_PARAMETER_CV_INPUT(seq " St.Seq. Output", 0, 0) \
+    {"Seq " seq " ST Seq", 1, NUM_ST_SEQUENCES, 1, kNT_unitNone, kNT_scalingNone, nullptr}, \
+    NT_PARAMETER_CV_INPUT(seq " Transpose Input", 0, 0) \
+    NT_PARAMETER_CV_INPUT(seq " Assignable CV Input", 0, 0)
+
+#define SEQUENCER_CONFIG_PARAMETERS(s, seq, cv, gate, reset) \
+    {"Seq " seq " Beats/Bar", 1, 16, 4, kNT_unitNone, kNT_scalingNone, nullptr}, \
+    {"Seq " seq " Bars", 1, 16, 1, kNT_unitNone, kNT_scalingNone, nullptr},
+
+#define SEQUENCER_BEAT_PARAMETERS(s, seq, cv, gate, reset) \
+    NT_PARAMETER_CV_INPUT(seq " Beat Input", 0, 0)
+
+#define SEQUENCER_ROUTING_PAGE(s, seq, cv, gate, reset) \
+    seqRoutingParam(s, kSeqParamCVInput), \
+    seqRoutingParam(s, kSeqParamGateInput), \
+    seqRoutingParam(s, kSeqParamResetOutput), \
+    seqRoutingParam(s, kSeqParamSelectOutput), \
+    seqRoutingParam(s, kSeqParamSelectValue), \
+    seqRoutingParam(s, kSeqParamTransposeInput), \
+    seqRoutingParam(s, kSeqParamAssignableCVInput),
+
+#define SEQUENCER_CONFIG_PAGE(s, seq, cv, gate, reset) \
+    seqConfigParam(s, kSeqParamBeatsPerBar), \
+    seqConfigParam(s, kSeqParamBars), \
+    kParamSeq1BeatInput + s,
+
+// Steps 1..8 of one lane, names starting with prefix ("" for lane 1); X is STEP_PARAMETERS or STEP_PAGE
+#define STEP_LIST(X, prefix) \
+    X(prefix, 1) \
+    X(prefix, 2) \
+    X(prefix, 3) \
+    X(prefix, 4) \
+    X(prefix, 5) \
+    X(prefix, 6) \
+    X(prefix, 7) \
+    X(prefix, 8)
+
+// rows in kStepParam order
+#define STEP_PARAMETERS(prefix, step) \
+    {prefix "Step" #step " Seq", 0, HighSeqModule::NUM_SEQUENCERS - 1, 0, kNT_unitEnum, kNT_scalingNone, enumStringsSequencers }, \
+    {prefix "Step" #step " Repeats", 0, HighSeqModule::MAX_REPEATS, 0, kNT_unitNone, kNT_scalingNone, nullptr}, \
+    {prefix "Step" #step " Switch", 0, 1, 1, kNT_unitEnum, kNT_scalingNone, enumStringsSwitch},
+
+#define STEP_PAGE(prefix, step) \
+    stepParam(step - 1, kStepParamSeq), \
+    stepParam(step - 1, kStepParamRepeats), \
+    stepParam(step - 1, kStepParamSwitch),
+
+// Arrangement instructions 1..12; X is ARRANGEMENT_PARAMETERS or ARRANGEMENT_PAGE
+#define ARRANGEMENT_LIST(X) \
+    X(1) \
+    X(2) \
+    X(3) \
+    X(4) \
+    X(5) \
+    X(6) \
+    X(7) \
+    X(8) \
+    X(9) \
+    X(10) \
+    X(11) \
+    X(12)
+
+#define ARRANGEMENT_PARAMETERS(n) \
+    {"Arrangement " #n, 0, SOURCE_END, 0, kNT_unitEnum, kNT_scalingNone, enumStringsArrangement},
+
+#define ARRANGEMENT_PAGE(n) \
+    kParamArrangement1 + n - 1,
+
+// Parameters of lanes 2..MAX_LANES, laid out as the kLaneParam enum
+
+#define LANE_PARAMETERS(lane) \
+    NT_PARAMETER_CV_OUTPUT(lane " Pitch CV Output", 0, 0) \
+    NT_PARAMETER_CV_OUTPUT(lane " Gate Output", 0, 0) \
+    NT_PARAMETER_CV_OUTPUT(lane " Assignable Output", 0, 0) \
+    {lane " Quantize Scale", 0, NUM_SCALES, 0, kNT_unitEnum, kNT_scalingNone, enumStringsScale}, \
+    {lane " Quantize Root", 0, SEMITONES - 1, 0, kNT_unitEnum, kNT_scalingNone, enumStringsRoot}, \
+    NT_PARAMETER_CV_OUTPUT(lane " Step Ramp Output", 0, 0) \
+    NT_PARAMETER_CV_OUTPUT(lane " Song Ramp Output", 0, 0) \
+    NT_PARAMETER_CV_OUTPUT(lane " Step CV Output", 0, 0) \
+    NT_PARAMETER_CV_OUTPUT(lane " End Gate Output", 0, 0) \
+    STEP_LIST(STEP_PARAMETERS, lane " ")
+
 // Parameter definitions
 static const _NT_parameter songSequencerParameters[] = {
     NT_PARAMETER_AUDIO_INPUT("Reset Input", 0, 1)   /* 0 is none */
@@ -215,119 +620,59 @@ static const _NT_parameter songSequencerParameters[] = {
     NT_PARAMETER_CV_OUTPUT("Gate Output", 0, 14)     // Output 2
     NT_PARAMETER_CV_OUTPUT("Assignable Output", 0, 0)
 
-    NT_PARAMETER_CV_INPUT("A CV Input", 0, 3)
-    NT_PARAMETER_CV_INPUT("A Gate Input", 0, 4)
-    NT_PARAMETER_CV_INPUT("A Reset Output", 0, 18)
-    NT_PARAMETER_CV_INPUT("A St.Seq. Output", 0, 0)
-    {"Seq A ST Seq", 1, 32, 1, kNT_unitNone, kNT_scalingNone, nullptr},
-    NT_PARAMETER_CV_INPUT("A Transpose Input", 0, 0)
-    NT_PARAMETER_CV_INPUT("A Assignable CV Input", 0, 0)
-
-    NT_PARAMETER_CV_INPUT("B CV Input", 0, 5)
-    NT_PARAMETER_CV_INPUT("B Gate Input", 0, 6)
-    NT_PARAMETER_CV_INPUT("B Reset Output", 0, 18)
-    NT_PARAMETER_CV_INPUT("B St.Seq. Output", 0, 0)
-    {"Seq B ST Seq", 1, 32, 1, kNT_unitNone, kNT_scalingNone, nullptr},
-    NT_PARAMETER_CV_INPUT("B Transpose Input", 0, 0)
-    NT_PARAMETER_CV_INPUT("B Assignable CV Input", 0, 0)
-
-    NT_PARAMETER_CV_INPUT("C CV Input", 0, 7)
-    NT_PARAMETER_CV_INPUT("C Gate Input", 0, 8)
-    NT_PARAMETER_CV_INPUT("C Reset Output", 0, 18)
-    NT_PARAMETER_CV_INPUT("C St.Seq. Output", 0, 0)
-    {"Seq C ST Seq", 1, 32, 1, kNT_unitNone, kNT_scalingNone, nullptr},
-    NT_PARAMETER_CV_INPUT("C Transpose Input", 0, 0)
-    NT_PARAMETER_CV_INPUT("C Assignable CV Input", 0, 0)
-
-    NT_PARAMETER_CV_INPUT("D CV Input", 0, 9)
-    NT_PARAMETER_CV_INPUT("D Gate Input", 0, 10)
-    NT_PARAMETER_CV_INPUT("D Reset Output", 0, 18)
-    NT_PARAMETER_CV_INPUT("D St.Seq. Output", 0, 0)
-    {"Seq D ST Seq", 1, 32, 1, kNT_unitNone, kNT_scalingNone, nullptr},
-    NT_PARAMETER_CV_INPUT("D Transpose Input", 0, 0)
-    NT_PARAMETER_CV_INPUT("D Assignable CV Input", 0, 0)
-
-    NT_PARAMETER_CV_INPUT("E CV Input", 0, 11)
-    NT_PARAMETER_CV_INPUT("E Gate Input", 0, 12)
-    NT_PARAMETER_CV_INPUT("E Reset Output", 0, 18)
-    NT_PARAMETER_CV_INPUT("E St.Seq. Output", 0, 0)
-    {"Seq E ST Seq", 1, 32, 1, kNT_unitNone, kNT_scalingNone, nullptr},
-    NT_PARAMETER_CV_INPUT("E Transpose Input", 0, 0)
-    NT_PARAMETER_CV_INPUT("E Assignable CV Input", 0, 0)
-
-    NT_PARAMETER_CV_INPUT("F CV Input", 0, 0)
-    NT_PARAMETER_CV_INPUT("F Gate Input", 0, 0)
-    NT_PARAMETER_CV_INPUT("F Reset Output", 0, 0)
-    NT_PARAMETER_CV_INPUT("FA St.Seq. Output", 0, 0)
-    {"Seq F ST Seq", 1, 32, 1, kNT_unitNone, kNT_scalingNone, nullptr},
-    NT_PARAMETER_CV_INPUT("F Transpose Input", 0, 0)
-    NT_PARAMETER_CV_INPUT("F Assignable CV Input", 0, 0)
-
-    NT_PARAMETER_CV_INPUT("G CV Input", 0, 0)
-    NT_PARAMETER_CV_INPUT("G Gate Input", 0, 0)
-    NT_PARAMETER_CV_INPUT("G Reset Output", 0, 0)
-    NT_PARAMETER_CV_INPUT("G St.Seq. Output", 0, 0)
-    {"Seq G ST Seq", 1, 32, 1, kNT_unitNone, kNT_scalingNone, nullptr},
-    NT_PARAMETER_CV_INPUT("G Transpose Input", 0, 0)
-    NT_PARAMETER_CV_INPUT("G Assignable CV Input", 0, 0)
-
-    NT_PARAMETER_CV_INPUT("H CV Input", 0, 0)
-    NT_PARAMETER_CV_INPUT("H Gate Input", 0, 0)
-    NT_PARAMETER_CV_INPUT("H Reset Output", 0, 0)
-    NT_PARAMETER_CV_INPUT("A St.Seq. Output", 0, 0)
-    {"Seq H ST Seq", 1, 32, 1, kNT_unitNone, kNT_scalingNone, nullptr},
-    NT_PARAMETER_CV_INPUT("H Transpose Input", 0, 0)
-    NT_PARAMETER_CV_INPUT("H Assignable CV Input", 0, 0)
-
-    {"Seq A Beats/Bar", 1, 16, 4, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Seq A Bars", 1, 16, 1, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Seq B Beats/Bar", 1, 16, 4, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Seq B Bars", 1, 16, 1, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Seq C Beats/Bar", 1, 16, 4, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Seq C Bars", 1, 16, 1, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Seq D Beats/Bar", 1, 16, 4, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Seq D Bars", 1, 16, 1, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Seq E Beats/Bar", 1, 16, 4, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Seq E Bars", 1, 16, 1, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Seq F Beats/Bar", 1, 16, 4, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Seq F Bars", 1, 16, 1, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Seq G Beats/Bar", 1, 16, 4, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Seq G Bars", 1, 16, 1, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Seq H Beats/Bar", 1, 16, 4, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Seq H Bars", 1, 16, 1, kNT_unitNone, kNT_scalingNone, nullptr},
-
-    {"Step1 Seq", 0, 7, 0, kNT_unitEnum, kNT_scalingNone, enumStringsSequencers },
-    {"Step1 Repeats", 0, 16, 0, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Step1 Switch", 0, 1, 1, kNT_unitEnum, kNT_scalingNone, enumStringsSwitch},
-
-    {"Step2 Seq", 0, 7, 0, kNT_unitEnum, kNT_scalingNone, enumStringsSequencers },
-    {"Step2 Repeats", 0, 16, 0, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Step2 Switch", 0, 1, 1, kNT_unitEnum, kNT_scalingNone, enumStringsSwitch},
-
-    {"Step3 Seq", 0, 7, 0, kNT_unitEnum, kNT_scalingNone, enumStringsSequencers },
-    {"Step3 Repeats", 0, 16, 0, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Step3 Switch", 0, 1, 1, kNT_unitEnum, kNT_scalingNone, enumStringsSwitch},
-
-    {"Step4 Seq", 0, 7, 0, kNT_unitEnum, kNT_scalingNone, enumStringsSequencers },
-    {"Step4 Repeats", 0, 16, 0, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Step4 Switch", 0, 1, 1, kNT_unitEnum, kNT_scalingNone, enumStringsSwitch},
-
-    {"Step5 Seq", 0, 7, 0, kNT_unitEnum, kNT_scalingNone, enumStringsSequencers },
-    {"Step5 Repeats", 0, 16, 0, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Step5 Switch", 0, 1, 1, kNT_unitEnum, kNT_scalingNone, enumStringsSwitch},
-
-    {"Step6 Seq", 0, 7, 0, kNT_unitEnum, kNT_scalingNone, enumStringsSequencers },
-    {"Step6 Repeats", 0, 16, 0, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Step6 Switch", 0, 1, 1, kNT_unitEnum, kNT_scalingNone, enumStringsSwitch},
-
-    {"Step7 Seq", 0, 7, 0, kNT_unitEnum, kNT_scalingNone, enumStringsSequencers },
-    {"Step7 Repeats", 0, 16, 0, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Step7 Switch", 0, 1, 1, kNT_unitEnum, kNT_scalingNone, enumStringsSwitch},
-
-    {"Step8 Seq", 0, 7, 0, kNT_unitEnum, kNT_scalingNone, enumStringsSequencers },
-    {"Step8 Repeats", 0, 16, 0, kNT_unitNone, kNT_scalingNone, nullptr},
-    {"Step8 Switch", 0, 1, 1, kNT_unitEnum, kNT_scalingNone, enumStringsSwitch}
+    SEQUENCER_LIST(SEQUENCER_ROUTING_PARAMETERS)
+
+    SEQUENCER_LIST(SEQUENCER_CONFIG_PARAMETERS)
+
+    STEP_LIST(STEP_PARAMETERS, "")
+
+    {"Sync", 0, 2, 0, kNT_unitEnum, kNT_scalingNone, enumStringsSync},
+    {"Sync Group", 1, NUM_SYNC_GROUPS, 1, kNT_unitNone, kNT_scalingNone, nullptr},
+
+    {"Quantize Scale", 0, NUM_SCALES, 0, kNT_unitEnum, kNT_scalingNone, enumStringsScale},
+    {"Quantize Root", 0, SEMITONES - 1, 0, kNT_unitEnum, kNT_scalingNone, enumStringsRoot},
+
+    {"St.Seq. Lead Frames", 0, MAX_SELECT_LEAD_FRAMES, 0, kNT_unitFrames, kNT_scalingNone, nullptr},
+    {"St.Seq. Lead", 0, 100, 0, kNT_unitPercent, kNT_scalingNone, nullptr},
+    {"Reset Lead", 0, MAX_RESET_LEAD_MS, 0, kNT_unitMs, kNT_scalingNone, nullptr},
+
+    SEQUENCER_LIST(SEQUENCER_BEAT_PARAMETERS)
+
+    {"Clock", 0, 1, 0, kNT_unitEnum, kNT_scalingNone, enumStringsClock},
+    {"Tempo", MIN_TEMPO * 10, MAX_TEMPO * 10, 1200, kNT_unitBPM, kNT_scaling10, nullptr},
+    NT_PARAMETER_CV_INPUT("Tempo CV Input", 0, 0)
+    NT_PARAMETER_CV_OUTPUT("Clock Output", 0, 0)
+
+    NT_PARAMETER_CV_OUTPUT("Step Ramp Output", 0, 0)
+    NT_PARAMETER_CV_OUTPUT("Song Ramp Output", 0, 0)
+    NT_PARAMETER_CV_OUTPUT("Step CV Output", 0, 0)
+    NT_PARAMETER_CV_OUTPUT("End Gate Output", 0, 0)
+
+    {"Song", 0, MAX_SONGS, 0, kNT_unitNone, kNT_scalingNone, nullptr},             // 0 = play the parameters
+    NT_PARAMETER_CV_INPUT("Song CV Input", 0, 0)
+    {"Song MIDI Channel", 0, 16, 0, kNT_unitNone, kNT_scalingNone, nullptr},       // program change selects, 0 = off
+    {"Store Song", 0, MAX_SONGS, 0, kNT_unitNone, kNT_scalingNone, nullptr},       // copies the parameters into a song
+
+    NT_PARAMETER_CV_INPUT("Jump CV Input", 0, 0)
+    NT_PARAMETER_CV_INPUT("Jump Trigger Input", 0, 0)
+    {"Jump Quantize", 0, 2, 0, kNT_unitEnum, kNT_scalingNone, enumStringsJump},
+
+    {"Step Order", 0, ORDER_RANDOM, 0, kNT_unitEnum, kNT_scalingNone, enumStringsStepOrder},
+    {"Random Seed", 0, MAX_ORDER_SEED, 0, kNT_unitNone, kNT_scalingNone, nullptr},
+
+    NT_PARAMETER_CV_INPUT("Repeats CV Input", 0, 0)
+    NT_PARAMETER_CV_INPUT("Bars CV Input", 0, 0)
+    NT_PARAMETER_CV_INPUT("Step Mask CV Input", 0, 0)
+
+    ARRANGEMENT_LIST(ARRANGEMENT_PARAMETERS)
+
+    LANE_PARAMETERS("L2")
+    LANE_PARAMETERS("L3")
+    LANE_PARAMETERS("L4")
 };
+static_assert(ARRAY_SIZE(songSequencerParameters) == kParamLane2Base + (MAX_LANES - 1) * kNumLaneParams,
+              "one LANE_PARAMETERS block per extra lane");
+static_assert(ARRAY_SIZE(songSequencerParameters) <= 256, "parameter page indices are uint8_t");
 
 // Parameter pages
 static const uint8_t routingPageParams[] = {
@@ -336,145 +681,264 @@ static const uint8_t routingPageParams[] = {
     kParamPitchCVOutput,
     kParamGateOutput,
     kParamAssignableOutput,
+    kParamQuantizeScale,
+    kParamQuantizeRoot,
+    kParamStepRampOutput,
+    kParamSongRampOutput,
+    kParamStepCVOutput,
+    kParamEndGateOutput,
+    kParamSyncMode,
+    kParamSyncGroup,
+    kParamSelectLeadFrames,
+    kParamSelectLeadPercent,
+    kParamResetLead,
+    kParamClockSource,
+    kParamTempo,
+    kParamTempoCVInput,
+    kParamClockOutput,
+    kParamJumpCVInput,
+    kParamJumpTriggerInput,
+    kParamJumpQuantize,
 };
 static const uint8_t sequencerAssignPageParams[] = {
-    kParamSeq1CVInput,
-    kParamSeq1GateInput,
-    kParamSeq1ResetOutput,
-    kParamSeq1SeqSelectOutput,
-    kParamSeq1SeqSelectValue,
-    kParamSeq1TransposeInput,
-    kParamSeq1AssignableCVInput,
-
-    kParamSeq2CVInput,
-    kParamSeq2GateInput,
-    kParamSeq2ResetOutput,
-    kParamSeq2SeqSelectOutput,
-    kParamSeq2SeqSelectValue,
-    kParamSeq2TransposeInput,
-    kParamSeq2AssignableCVInput,
-
-    kParamSeq3CVInput,
-    kParamSeq3GateInput,
-    kParamSeq3ResetOutput,
-    kParamSeq3SeqSelectOutput,
-    kParamSeq3SeqSelectValue,
-    kParamSeq3TransposeInput,
-    kParamSeq3AssignableCVInput,
-
-    kParamSeq4CVInput,
-    kParamSeq4GateInput,
-    kParamSeq4ResetOutput,
-    kParamSeq4SeqSelectOutput,
-    kParamSeq4SeqSelectValue,
-    kParamSeq4TransposeInput,
-    kParamSeq4AssignableCVInput,
-
-    kParamSeq5CVInput,
-    kParamSeq5GateInput,
-    kParamSeq5ResetOutput,
-    kParamSeq5SeqSelectOutput,
-    kParamSeq5SeqSelectValue,
-    kParamSeq5TransposeInput,
-    kParamSeq5AssignableCVInput,
-
-    kParamSeq6CVInput,
-    kParamSeq6GateInput,
-    kParamSeq6ResetOutput,
-    kParamSeq6SeqSelectOutput,
-    kParamSeq6SeqSelectValue,
-    kParamSeq6TransposeInput,
-    kParamSeq6AssignableCVInput,
-
-    kParamSeq7CVInput,
-    kParamSeq7GateInput,
-    kParamSeq7ResetOutput,
-    kParamSeq7SeqSelectOutput,
-    kParamSeq7SeqSelectValue,
-    kParamSeq7TransposeInput,
-    kParamSeq7AssignableCVInput,
-
-    kParamSeq8CVInput,
-    kParamSeq8GateInput,
-    kParamSeq8ResetOutput,
-    kParamSeq8SeqSelectOutput,
-    kParamSeq8SeqSelectValue,
-    kParamSeq8TransposeInput,
-    kParamSeq8AssignableCVInput
-
+    SEQUENCER_LIST(SEQUENCER_ROUTING_PAGE)
 };
 static const uint8_t sequencerConfigPageParams[] = {
-    kParamSeq1BeatsPerBar,
-    kParamSeq1Bars,
-    kParamSeq2BeatsPerBar,
-    kParamSeq2Bars,
-    kParamSeq3BeatsPerBar,
-    kParamSeq3Bars,
-    kParamSeq4BeatsPerBar,
-    kParamSeq4Bars,
-    kParamSeq5BeatsPerBar,
-    kParamSeq5Bars,
-    kParamSeq6BeatsPerBar,
-    kParamSeq6Bars,
-    kParamSeq7BeatsPerBar,
-    kParamSeq7Bars,
-    kParamSeq8BeatsPerBar,
-    kParamSeq8Bars
+    SEQUENCER_LIST(SEQUENCER_CONFIG_PAGE)
 };
 static const uint8_t stepConfigPageParams[] = {
-    kParamStep1Seq,
-    kParamStep1Repeats,
-    kParamStep1Switch,
-    kParamStep2Seq,
-    kParamStep2Repeats,
-    kParamStep2Switch,
-    kParamStep3Seq,
-    kParamStep3Repeats,
-    kParamStep3Switch,
-    kParamStep4Seq,
-    kParamStep4Repeats,
-    kParamStep4Switch,
-    kParamStep5Seq,
-    kParamStep5Repeats,
-    kParamStep5Switch,
-    kParamStep6Seq,
-    kParamStep6Repeats,
-    kParamStep6Switch,
-    kParamStep7Seq,
-    kParamStep7Repeats,
-    kParamStep7Switch,
-    kParamStep8Seq,
-    kParamStep8Repeats,
-    kParamStep8Switch
+    STEP_LIST(STEP_PAGE, "")
+};
+static_assert(ARRAY_SIZE(sequencerAssignPageParams) == HighSeqModule::NUM_SEQUENCERS * kNumSeqRoutingParams,
+    "SEQUENCER_LIST names every sequencer");
+static_assert(ARRAY_SIZE(stepConfigPageParams) == HighSeqModule::NUM_STEPS * kNumStepParams, "STEP_LIST names every step");
+static_assert(STATE_STEPS == HighSeqModule::NUM_STEPS, "SongState carries the whole grid");
+static const uint8_t songBankPageParams[] = {
+    kParamSong,
+    kParamSongCVInput,
+    kParamSongMidiChannel,
+    kParamStoreSong,
+};
+static const uint8_t modulationPageParams[] = {
+    kParamRepeatsCVInput,
+    kParamBarsCVInput,
+    kParamStepMaskCVInput,
 };
+static const uint8_t arrangementPageParams[] = {
+    kParamStepOrder,
+    kParamOrderSeed,
+    ARRANGEMENT_LIST(ARRANGEMENT_PAGE)
+};
+static_assert(ARRAY_SIZE(arrangementPageParams) == 2 + SongProgram::MAX_INSTRUCTIONS,
+    "ARRANGEMENT_LIST names every instruction");
 static const _NT_parameterPage songSequencerParameterPages[] = {
     {"Routing", ARRAY_SIZE(routingPageParams), routingPageParams},
     {"Seq Assign", ARRAY_SIZE(sequencerAssignPageParams), sequencerAssignPageParams},
     {"Seq Config", ARRAY_SIZE(sequencerConfigPageParams), sequencerConfigPageParams},
-    {"Step Config", ARRAY_SIZE(stepConfigPageParams), stepConfigPageParams}
+    {"Step Config", ARRAY_SIZE(stepConfigPageParams), stepConfigPageParams},
+    {"Song Bank", ARRAY_SIZE(songBankPageParams), songBankPageParams},
+    {"Arrangement", ARRAY_SIZE(arrangementPageParams), arrangementPageParams},
+    {"Modulation", ARRAY_SIZE(modulationPageParams), modulationPageParams}
+};
+static const int NUM_FIXED_PAGES = ARRAY_SIZE(songSequencerParameterPages);
+
+// lane pages are built into static memory by initialise()
+static const char* const lanePageNames[] = {
+    "Lane 2",
+    "Lane 3",
+    "Lane 4",
 };
+static_assert(ARRAY_SIZE(lanePageNames) == MAX_LANES - 1, "one page name per extra lane");
 
-static const _NT_parameterPages songSequencerParameterPagesStruct = {
-    ARRAY_SIZE(songSequencerParameterPages),
-    songSequencerParameterPages
+enum {
+    kSpecLanes,
+    kSpecTrace,
+    kSpecSongs,
+    kSpecVoices,
 };
 
+static const _NT_specification songSequencerSpecifications[] = {
+    { "Lanes", 1, MAX_LANES, 1, kNT_typeGeneric },
+    { "Trace", 0, MAX_TRACE_UNITS, 0, kNT_typeGeneric },   // x256 records of event trace in DRAM, 0 = off
+    { "Songs", 0, MAX_SONGS, 0, kNT_typeGeneric },         // song bank size, 0 = no bank
+    { "Voices", 1, MAX_VOICES, 1, kNT_typeGeneric },       // consecutive buses per pitch, gate and assignable path
+};
+
+// Tables shared by every SongSequencer instance; built once in initialise()
+struct SongSequencerStatic {
+    float selectVolts[NUM_ST_SEQUENCES];                  // St.Seq. output voltage for sequence 1..32
+    int triggerFrames[ARRAY_SIZE(knownSampleRates)];      // reset trigger length per known sample rate
+    char digits[MAX_DIGIT_STRING + 1][4];                 // "0".."256" for the display
+    char seqLabels[HighSeqModule::NUM_SEQUENCERS][2];     // "A".."H"
+    _NT_parameterPage pages[NUM_FIXED_PAGES + MAX_LANES - 1];  // fixed pages, then Lane 2..MAX_LANES
+    uint8_t lanePageParams[MAX_LANES - 1][kNumLaneParams];
+    SyncSlot syncSlots[NUM_SYNC_GROUPS];                  // entries follow this struct in static memory
+    float quantizeTables[NUM_SCALES][SEMITONES][QUANTIZE_BINS];  // per scale and root: nearest note in volts from the octave, per bin
+};
+
+static SongSequencerStatic* songStatic = nullptr;
+
+int calcTriggerFrames (uint32_t sampleRate) {
+    // same float arithmetic the per-instance constants used, rounded up to the frame the trigger ends on
+    float frameTimeMs = (1.f / sampleRate) * 1000.f;
+    return (int) ceilf(TRIGGER_FRAME_TARGET_MS / frameTimeMs);
+}
+
+int triggerFramesForSampleRate (uint32_t sampleRate) {
+    for (unsigned int i = 0; i < ARRAY_SIZE(knownSampleRates); i++) {
+        if (knownSampleRates[i] == sampleRate)
+            return songStatic->triggerFrames[i];
+    }
+    return calcTriggerFrames(sampleRate);
+}
+
+void buildQuantizeTable (float* table, uint16_t mask, int root) {
+    // for each half semitone bin of an octave, the scale note nearest its centre; may be in the octave below or above
+    for (int bin = 0; bin < QUANTIZE_BINS; bin++) {
+        float centre = (bin + 0.5f) * 0.5f;
+        int nearest = 0;
+        float nearestDistance = 1000.f;
+        for (int note = -SEMITONES; note < 2 * SEMITONES; note++) {
+            if (!(mask & (1 << ((note - root + 2 * SEMITONES) % SEMITONES))))
+                continue;
+            float distance = fabsf(note - centre);
+            if (distance < nearestDistance) {
+                nearest = note;
+                nearestDistance = distance;
+            }
+        }
+        table[bin] = nearest * SEQ12THV;
+    }
+}
+
+const float* quantizeTableFor (int scale, int root) {
+    // scale 0 is Off
+    if (scale < 1 || scale > NUM_SCALES || root < 0 || root >= SEMITONES)
+        return nullptr;
+    return songStatic->quantizeTables[scale - 1][root];
+}
+
+const char* digitString (int value, char* buffer) {
+    // shared glyph string when in range, otherwise format into the caller's buffer
+    if (value >= 0 && value <= MAX_DIGIT_STRING)
+        return songStatic->digits[value];
+    NT_intToString(buffer, value);
+    return buffer;
+}
+
+
+void assignLaneParameters (SongSequencer* alg, int lane) {
+    HighSeqModule& module = alg->lanes[lane].highSeqModule;
+    for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++) {
+        module.sequencers[s].set_beatsPerBar(alg->v[seqConfigParam(s, kSeqParamBeatsPerBar)]);
+        module.sequencers[s].set_bars(alg->v[seqConfigParam(s, kSeqParamBars)]);
+    }
+    for (int i = 0; i < HighSeqModule::NUM_STEPS; i++) {
+        int base = laneParam(lane, kLaneParamStep1Seq + i * kNumStepParams);
+        module.steps[i].set_sequencer(alg->v[base]);
+        module.steps[i].set_repeats(alg->v[base + 1]);
+        module.steps[i].set_switch(static_cast<SWITCHSTATE>(alg->v[base + 2]));
+    }
+}
 
 void assignSequencerParameters (_NT_algorithm* self) {
 
     SongSequencer* alg = static_cast<SongSequencer*>(self);
 
-    // Initialize highSeqModule with default parameter values
-    for (int s = 0; s < alg->highSeqModule.NUM_SEQUENCERS; s++) {
-        alg->highSeqModule.sequencers[s].set_beatsPerBar(alg->v[kParamSeq1BeatsPerBar + s * 2]);
-        alg->highSeqModule.sequencers[s].set_bars(alg->v[kParamSeq1Bars + s * 2]);
+    // Initialize each lane's highSeqModule with the current parameter values; lanes playing a bank song keep it
+    for (int lane = 0; lane < alg->numLanes; lane++) {
+        if (!alg->lanes[lane].storedSong)
+            assignLaneParameters(alg, lane);
     }
-    for (int i = 0; i < alg->highSeqModule.NUM_STEPS; i++) {
-        int base = kParamStep1Seq + i * 3;
-        alg->highSeqModule.steps[i].set_sequencer(alg->v[base]);
-        alg->highSeqModule.steps[i].set_repeats(alg->v[base + 1]);
-        alg->highSeqModule.steps[i].set_switch(static_cast<SWITCHSTATE>(alg->v[base + 2]));
+}
+
+void storeSong (SongSequencer* alg, int song) {
+    // audio thread, at the start of a block: the parameters as they stand into bank song 1..numSongs.
+    // A lane playing it carries on with what it loaded and takes the new song at its next step boundary
+    StoredSong& stored = alg->songs[song - 1];
+    for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++) {
+        stored.beatsPerBar[s] = alg->v[seqConfigParam(s, kSeqParamBeatsPerBar)];
+        stored.bars[s] = alg->v[seqConfigParam(s, kSeqParamBars)];
+        stored.selectValue[s] = alg->v[seqRoutingParam(s, kSeqParamSelectValue)];
+    }
+    for (int lane = 0; lane < alg->numLanes; lane++) {
+        for (int i = 0; i < HighSeqModule::NUM_STEPS; i++) {
+            int base = laneParam(lane, kLaneParamStep1Seq + i * kNumStepParams);
+            stored.stepSeq[lane][i] = alg->v[base];
+            stored.stepRepeats[lane][i] = alg->v[base + 1];
+            stored.stepSwitch[lane][i] = alg->v[base + 2];
+        }
+    }
+    stored.stored = true;
+    for (int lane = 0; lane < alg->numLanes; lane++) {
+        if (alg->lanes[lane].song == song)
+            alg->lanes[lane].songStale = true;
+    }
+}
+
+void loadSong (SongSequencer* alg, int lane, int song) {
+    // at a step boundary: the lane's module from bank song 1..numSongs, or from the parameters for 0
+    // (or an empty song). Beats per bar and bars that change restart their sequencer, as an edit would
+    SongLane& songLane = alg->lanes[lane];
+    songLane.song = song;
+    songLane.songStale = false;
+    songLane.storedSong = (song > 0 && alg->songs[song - 1].stored) ? &alg->songs[song - 1] : nullptr;
+    if (!songLane.storedSong) {
+        assignLaneParameters(alg, lane);
+        songLane.highSeqModule.refreshOrder();
+        return;
     }
+    songLane.storedSong->load(songLane.highSeqModule, lane);
+    for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++)
+        songLane.selectValue[s] = songLane.storedSong->selectValue[s];
+}
+
+inline int selectValue (SongSequencer* alg, const SongLane& lane, int sequencer) {
+    // St.Seq. sequence 1..32 for a sequencer: the lane's bank song as it loaded it, or the Seq X ST Seq parameter
+    if (lane.storedSong)
+        return lane.selectValue[sequencer];
+    return alg->v[seqRoutingParam(sequencer, kSeqParamSelectValue)];
+}
+
+
+uint32_t traceBytes (const int32_t* specifications) {
+    // DRAM: the trace records, then the song bank, then the pending Arrangement program and the one lanes play
+    return specifications[kSpecTrace] * TRACE_RECORDS_PER_UNIT * sizeof(TraceRecord);
+}
+
+uint32_t songBankBytes (const int32_t* specifications) {
+    return specifications[kSpecSongs] * sizeof(StoredSong);
+}
+
+void compileProgram (SongSequencer* alg) {
+    // off the audio thread, into the pending program only, bracketed by the version going odd and back
+    // to even the way a snapshot is published; the lanes never see this copy
+    alg->pendingVersion = alg->pendingVersion + 1;
+    std::atomic_thread_fence(std::memory_order_release);
+    alg->programDropped = alg->pendingProgram->compile(&alg->v[kParamArrangement1], SongProgram::MAX_INSTRUCTIONS);
+    std::atomic_thread_fence(std::memory_order_release);
+    alg->pendingVersion = alg->pendingVersion + 1;
+}
+
+void takeProgram (SongSequencer* alg) {
+    // audio thread, at the start of a block: copy a newer compile into the program the lanes play. A copy
+    // a compile overlapped is thrown away and taken again next block, so the lanes only ever see a whole
+    // program, and the new one is first run at their next step boundary
+    uint32_t version = alg->pendingVersion;
+    if ((version == alg->programVersion) || (version & 1))
+        return;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    SongProgram taken = *alg->pendingProgram;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (alg->pendingVersion != version)
+        return;
+    *alg->program = taken;
+    alg->programVersion = version;
+}
+
+uint32_t songSequencerSramSize (int lanes) {
+    // the algorithm struct, then its lanes, then one event slot per frame
+    return sizeof(SongSequencer) + lanes * sizeof(SongLane) + NT_globals.maxFramesPerStep * sizeof(SongEvent);
 }
 
 
@@ -483,33 +947,114 @@ _NT_algorithm* constructSongSequencer(const _NT_algorithmMemoryPtrs& ptrs,
                                       const int32_t* specifications) {
     SongSequencer* alg = new (static_cast<void*>(ptrs.sram)) SongSequencer();
     alg->parameters = songSequencerParameters;
-    alg->parameterPages = &songSequencerParameterPagesStruct;
 
-    // Initialize highSeqModule with default parameter values
-    for (int s = 0; s < alg->highSeqModule.NUM_SEQUENCERS; s++) {
-        alg->highSeqModule.sequencers[s].set_beatsPerBar(alg->v[kParamSeq1BeatsPerBar + s * 2]);
-        alg->highSeqModule.sequencers[s].set_bars(alg->v[kParamSeq1Bars + s * 2]);
+    alg->numLanes = specifications[kSpecLanes];
+    alg->voices = specifications[kSpecVoices];
+    alg->parameterPagesStruct.numPages = NUM_FIXED_PAGES + alg->numLanes - 1;
+    alg->parameterPagesStruct.pages = songStatic->pages;
+    alg->parameterPages = &alg->parameterPagesStruct;
+
+    alg->lanes = reinterpret_cast<SongLane*>(ptrs.sram + sizeof(SongSequencer));
+    for (int lane = 0; lane < alg->numLanes; lane++) {
+        SongLane* songLane = new (static_cast<void*>(&alg->lanes[lane])) SongLane();
+        songLane->pitchBusOUT = -1;
+        songLane->gateBusOUT = -1;
+        songLane->assignableBusOUT = -1;
+        songLane->stepRampBusOUT = -1;
+        songLane->songRampBusOUT = -1;
+        songLane->stepCVBusOUT = -1;
+        songLane->endGateBusOUT = -1;
+        songLane->quantizeTable = nullptr;
+        songLane->triggerActive = false;
+        songLane->triggerFrameCounter = 0;
+        songLane->triggerHandled = false;
+        songLane->triggerPredicted = false;
+        songLane->selectorVoltsOut = 0.f;
+        songLane->song = 0;
+        songLane->storedSong = nullptr;
+        songLane->songStale = false;
+        songLane->jumpStep = -1;
+        songLane->songBeats = 0;
+        songLane->endsPass = false;
+        songLane->passBeats = 0;
     }
-    for (int i = 0; i < alg->highSeqModule.NUM_STEPS; i++) {
-        int base = kParamStep1Seq + i * 3;
-        alg->highSeqModule.steps[i].set_sequencer(alg->v[base]);
-        alg->highSeqModule.steps[i].set_repeats(alg->v[base + 1]);
-        alg->highSeqModule.steps[i].set_switch(static_cast<SWITCHSTATE>(alg->v[base + 2]));
+    alg->events = reinterpret_cast<SongEvent*>(alg->lanes + alg->numLanes);
+    alg->maxEvents = NT_globals.maxFramesPerStep;
+    alg->beatLevels = 0;
+    alg->clockPhase = 0;
+    alg->clockIncrement = 0;
+    alg->syncPublishSeen = 0;
+    alg->leaderStep = -1;
+    alg->repeatOffset = 0;
+    alg->barsOffset = 0;
+    alg->stepMask = ~0u;
+
+    // Initialize highSeqModule with default parameter values
+    assignSequencerParameters(alg);
+    for (int lane = 0; lane < alg->numLanes; lane++) {
+        alg->lanes[lane].highSeqModule.reset();
+        alg->lanes[lane].highSeqModule.assertInitialized();
     }
     alg->editMode = false;
-    alg->highSeqModule.reset();
-    alg->highSeqModule.assertInitialized();
-
-    alg->triggerActive = false;
-    alg->triggerFrameCounter = 0;
-    alg->triggerHandled = false;
-
-    alg->SAMPLE_RATE = NT_globals.sampleRate;
-    alg->FRAME_TIME_MS = (1.f/alg->SAMPLE_RATE) * 1000.f;
-    alg->TRIGGER_FRAME_TARGET_MS = 25.0f;
-    alg->TRIGGER_FRAMES_NEEDED = alg->TRIGGER_FRAME_TARGET_MS / alg->FRAME_TIME_MS;
-
-    alg->selectorVoltsOut = 0.f;
+    alg->uiLane = 0;
+    alg->uiPage = UIPAGE_GRID;
+    alg->traceScroll = 0;
+    alg->parametersDirty = true;
+    alg->lastEditedParam = -1;
+
+    alg->trace.init(reinterpret_cast<TraceRecord*>(ptrs.dram), specifications[kSpecTrace] * TRACE_RECORDS_PER_UNIT);
+    alg->songs = reinterpret_cast<StoredSong*>(ptrs.dram + traceBytes(specifications));
+    alg->numSongs = specifications[kSpecSongs];
+    for (int song = 0; song < alg->numSongs; song++)
+        alg->songs[song].stored = false;
+    alg->storeRequests.store(0);
+    alg->requestedSong = 0;
+    SongProgram* programs = new (static_cast<void*>(ptrs.dram + traceBytes(specifications) + songBankBytes(specifications))) SongProgram[2];
+    alg->pendingProgram = &programs[0];
+    alg->program = &programs[1];
+    alg->pendingVersion = 0;
+    alg->programVersion = 0;
+    alg->programDropped = 0;
+    compileProgram(alg);
+    takeProgram(alg);
+    alg->resetWasHigh = false;
+
+    alg->triggerFramesNeeded = triggerFramesForSampleRate(NT_globals.sampleRate);
+
+    alg->beat.lastBeatFrame = NO_BEAT;
+    alg->beat.lastPeriod = 0;
+    alg->beat.smoothedPeriod = 0;
+    alg->beat.stableBeats = 0;
+    alg->selectLead = 0;
+    alg->resetLead = 0;
+
+    alg->blockCount = 0;
+    alg->steadyBlocks = 0;
+#ifdef SONGSEQ_DEBUG
+    alg->faultBlocks = 0;
+    alg->faultMask = 0;
+#endif
+#ifdef SONGSEQ_PROFILE
+    alg->windowCycles = 0;
+    alg->windowFrames = 0;
+    alg->windowBlocks = 0;
+    alg->blockCycles = 0;
+    alg->frameCycles = 0;
+    alg->peakCycles = 0;
+    alg->peakFrames = 0;
+    alg->peakFrameCycles = 0;
+#endif
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        alg->stepLatency[bucket] = 0;
+        alg->resetLatency[bucket] = 0;
+    }
+    for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++)
+        alg->seqBeatFrame[s] = NO_BEAT;
+    alg->sramBytes = req.sram;
+    alg->dramBytes = req.dram;
+    alg->displayState = SongState();
+    alg->displayState.masterStep = -1;
+    alg->displayState.assignedSeq = -1;
 
     alg->resetdebug = false;
     alg->resetdebugever = false;
@@ -517,230 +1062,928 @@ _NT_algorithm* constructSongSequencer(const _NT_algorithmMemoryPtrs& ptrs,
     return alg;
 }
 
-void distributeBeatVoltage (float beatVoltage, SongSequencer* alg) {
-    // share beat input across all sequencers (different than VCV rack where each seq. has own beat input)
-    for (int sequencer = 0; sequencer < alg->highSeqModule.NUM_SEQUENCERS; sequencer++) {
-        if (beatVoltage < 3.0f) {
-            alg->highSeqModule.sequencers[sequencer].set_beatState(BEATSTATE::LOW);
+inline bool validBus (int bus) {
+    return (bus >= 0 && bus < NUM_BUSES);
+}
+
+void distributeBeats (uint8_t beats, HighSeqModule& module) {
+    // each sequencer counts the edges on its own beat input, or on the shared one (different than VCV rack
+    // only in that the shared input is the default)
+    for (int sequencer = 0; sequencer < HighSeqModule::NUM_SEQUENCERS; sequencer++)
+        module.sequencers[sequencer].set_beatState((beats & (1 << sequencer)) ? BEATSTATE::FIRSTHIGH : BEATSTATE::LOW);
+}
+
+int buildSongEvents (SongSequencer* alg, const float* beatInput, const float* resetInput, const float* jumpInput,
+                     const float* busFrames, float* clockOutput, int numFrames) {
+    // one decode of the beat and reset inputs, shared by all lanes. Only frames with a rising beat edge
+    // or a high reset are listed; the beat levels are carried over from the end of the previous block.
+    // Beat lanes: 0..7 the sequencers, BEAT_LANE_SHARED the Beat input itself. Every routed bus is compared
+    // once, into the lanes it clocks, 4 frames at a time with one 16 bit field per frame, so the edges of
+    // all lanes over those frames come out of one shift and mask however many beat inputs are in use.
+    // The Jump Trigger input rides along as BEAT_LANE_JUMP.
+    // The internal clock feeds the shared lanes straight from its phase, and is written to clockOutput
+    // before the inputs are read, so a sequencer may take its beat from that bus as well
+    const float* sources[2 + HighSeqModule::NUM_SEQUENCERS];
+    uint64_t sourceLanes[2 + HighSeqModule::NUM_SEQUENCERS];
+    int numSources = 0;
+    uint32_t sharedLanes = 1u << BEAT_LANE_SHARED;
+    for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++) {
+        int bus = alg->sequencerBeatInput[s];
+        if (!validBus(bus)) {
+            sharedLanes |= 1u << s;
+            continue;
         }
-        else {  // voltage is HIGH
-            if (alg->highSeqModule.sequencers[sequencer].getbeatState() == BEATSTATE::LOW) {
-                alg->highSeqModule.sequencers[sequencer].set_beatState(BEATSTATE::FIRSTHIGH);
-                // cout << "SET FIRSTHIGH for seq: " << s << endl;
+        const float* input = busFrames + bus * numFrames;
+        int source = 0;
+        while (source < numSources && sources[source] != input)
+            source++;
+        if (source == numSources) {
+            sources[numSources] = input;
+            sourceLanes[numSources++] = 0;
+        }
+        sourceLanes[source] |= (uint64_t) (1u << s) * BEAT_FRAME_REPEAT;
+    }
+    if (beatInput) {
+        sources[numSources] = beatInput;
+        sourceLanes[numSources++] = (uint64_t) sharedLanes * BEAT_FRAME_REPEAT;
+    }
+    if (jumpInput) {
+        sources[numSources] = jumpInput;
+        sourceLanes[numSources++] = (uint64_t) (1u << BEAT_LANE_JUMP) * BEAT_FRAME_REPEAT;
+    }
+
+    int numEvents = 0;
+    uint64_t previous = alg->beatLevels;
+    uint32_t phase = alg->clockPhase;
+    for (int frame = 0; frame < numFrames; frame += BEAT_GROUP_FRAMES) {
+        uint64_t levels = 0;
+        if (alg->clockIncrement) {
+            uint64_t high = 0;
+            for (int f = 0; f < BEAT_GROUP_FRAMES; f++) {
+                high |= (uint64_t) (~phase >> 31) << (16 * f);
+                phase += alg->clockIncrement;
             }
-            else if (alg->highSeqModule.sequencers[sequencer].getbeatState() == BEATSTATE::FIRSTHIGH) {
-                alg->highSeqModule.sequencers[sequencer].set_beatState(BEATSTATE::STILLHIGH);
-                // cout << "FIRSTHIGH --> STILLHIGH for seq: " << s << endl;
+            levels = (high * 0xFFFF) & ((uint64_t) sharedLanes * BEAT_FRAME_REPEAT);
+            if (clockOutput) {
+                for (int f = 0; f < BEAT_GROUP_FRAMES; f++)
+                    clockOutput[frame + f] = ((high >> (16 * f)) & 1) ? 10.0f : 0.0f;
             }
-            else {
-                alg->highSeqModule.sequencers[sequencer].set_beatState(BEATSTATE::STILLHIGH);
-                // cout << "SET STILLHIGH for seq: s" << s << endl;
+        }
+        for (int source = 0; source < numSources; source++) {
+            const float* input = sources[source] + frame;
+            uint64_t high = (uint64_t) (input[0] >= 3.0f) | ((uint64_t) (input[1] >= 3.0f) << 16) |
+                            ((uint64_t) (input[2] >= 3.0f) << 32) | ((uint64_t) (input[3] >= 3.0f) << 48);
+            levels |= (high * 0xFFFF) & sourceLanes[source];
+        }
+        uint64_t edges = levels & ~((levels << 16) | previous);
+        previous = levels >> 48;
+
+        for (int f = 0; f < BEAT_GROUP_FRAMES; f++) {
+            uint32_t laneEdges = (uint32_t) (edges >> (16 * f)) & 0xFFFF;
+            uint8_t flags = (laneEdges & (1u << BEAT_LANE_SHARED)) ? EVENT_BEAT : 0;
+            if (resetInput && resetInput[frame + f] > 3.0f)
+                flags |= EVENT_RESET;
+            if (laneEdges & (1u << BEAT_LANE_JUMP))
+                flags |= EVENT_JUMP;
+
+            if ((flags || laneEdges) && numEvents < alg->maxEvents) {
+                alg->events[numEvents].frame = frame + f;
+                alg->events[numEvents].flags = flags;
+                alg->events[numEvents].beats = laneEdges & 0xFF;
+                numEvents++;
             }
-        } // voltage is high
-    } // sequencer loop
+        }
+    }
+    alg->beatLevels = previous;
+    alg->clockPhase = phase;
+    return numEvents;
 }
 
+void trackBeat (BeatTracker& beat, int frame) {
+    // integer running average of the beat period; a beat far off the average restarts it at the new period
+    if (beat.lastBeatFrame != NO_BEAT)
+        beat.lastPeriod = frame - beat.lastBeatFrame;
+    beat.lastBeatFrame = frame;
+    if (beat.lastPeriod <= 0 || beat.lastPeriod > MAX_BEAT_PERIOD) {
+        beat.lastPeriod = 0;
+        beat.smoothedPeriod = 0;
+        beat.stableBeats = 0;
+        return;
+    }
+    int period = beat.lastPeriod << BEAT_PERIOD_SHIFT;
+    int error = period - beat.smoothedPeriod;
+    if (beat.smoothedPeriod > 0 && abs(error) <= (beat.smoothedPeriod >> BEAT_TOLERANCE_SHIFT)) {
+        beat.smoothedPeriod += error >> BEAT_SMOOTHING_SHIFT;
+        beat.stableBeats += (beat.stableBeats < MIN_STABLE_BEATS) ? 1 : 0;
+    } else {
+        beat.smoothedPeriod = period;
+        beat.stableBeats = 0;
+    }
+}
 
-void stepSongSequencer(_NT_algorithm* self, float* busFrames, int numFramesBy4) {
-    SongSequencer* alg = static_cast<SongSequencer*>(self);
+void advanceBeatTracker (BeatTracker& beat, int numFrames) {
+    // keep the last beat relative to the next block
+    beat.lastBeatFrame = (beat.lastBeatFrame > NO_BEAT + numFrames) ? beat.lastBeatFrame - numFrames : NO_BEAT;
+}
 
-    int numFrames = numFramesBy4 * 4;
+inline int beatPeriod (const BeatTracker& beat) {
+    // frames, 0 until two beats have been seen
+    return (beat.smoothedPeriod + (1 << (BEAT_PERIOD_SHIFT - 1))) >> BEAT_PERIOD_SHIFT;
+}
 
-    int resetBusIN = self->v[kParamResetInput] - 1;
-    int beatBusIN = self->v[kParamBeatInput] - 1;
-    int pitchBusOUT = self->v[kParamPitchCVOutput] - 1;
-    int gateBusOUT = self->v[kParamGateOutput] - 1;
-    int assignableBusOUT = self->v[kParamAssignableOutput] - 1;
+inline bool beatIsStable (const BeatTracker& beat) {
+    return beat.stableBeats >= MIN_STABLE_BEATS;
+}
 
-    // Update sequencer input and output bus assignments
-    alg->sequencerCVInput[0] = self->v[kParamSeq1CVInput] - 1;
-    alg->sequencerGateInput[0] = self->v[kParamSeq1GateInput] - 1;
-    alg->sequencerResetOutput[0] = self->v[kParamSeq1ResetOutput] - 1;
-    alg->sequencerSelectOutput[0] = self->v[kParamSeq1SeqSelectOutput] - 1;
-    alg->sequencerTransposeInput[0] = self->v[kParamSeq1TransposeInput] - 1;
-    alg->sequencerCVAssignableInput[0] = self->v[kParamSeq1AssignableCVInput] - 1;
-
-    alg->sequencerCVInput[1] = self->v[kParamSeq2CVInput] - 1;
-    alg->sequencerGateInput[1] = self->v[kParamSeq2GateInput] - 1;
-    alg->sequencerResetOutput[1] = self->v[kParamSeq2ResetOutput] - 1;
-    alg->sequencerSelectOutput[1] = self->v[kParamSeq2SeqSelectOutput] - 1;
-    alg->sequencerTransposeInput[1] = self->v[kParamSeq2TransposeInput] - 1;
-    alg->sequencerCVAssignableInput[1] = self->v[kParamSeq2AssignableCVInput] - 1;
-
-    alg->sequencerCVInput[2] = self->v[kParamSeq3CVInput] - 1;
-    alg->sequencerGateInput[2] = self->v[kParamSeq3GateInput] - 1;
-    alg->sequencerResetOutput[2] = self->v[kParamSeq3ResetOutput] - 1;
-    alg->sequencerSelectOutput[2] = self->v[kParamSeq3SeqSelectOutput] - 1;
-    alg->sequencerTransposeInput[2] = self->v[kParamSeq3TransposeInput] - 1;
-    alg->sequencerCVAssignableInput[2] = self->v[kParamSeq3AssignableCVInput] - 1;
-
-    alg->sequencerCVInput[3] = self->v[kParamSeq4CVInput] - 1;
-    alg->sequencerGateInput[3] = self->v[kParamSeq4GateInput] - 1;
-    alg->sequencerResetOutput[3] = self->v[kParamSeq4ResetOutput] - 1;
-    alg->sequencerSelectOutput[3] = self->v[kParamSeq4SeqSelectOutput] - 1;
-    alg->sequencerTransposeInput[3] = self->v[kParamSeq4TransposeInput] - 1;
-    alg->sequencerCVAssignableInput[3] = self->v[kParamSeq4AssignableCVInput] - 1;
-
-    alg->sequencerCVInput[4] = self->v[kParamSeq5CVInput] - 1;
-    alg->sequencerGateInput[4] = self->v[kParamSeq5GateInput] - 1;
-    alg->sequencerResetOutput[4] = self->v[kParamSeq5ResetOutput] - 1;
-    alg->sequencerSelectOutput[4] = self->v[kParamSeq5SeqSelectOutput] - 1;
-    alg->sequencerTransposeInput[4] = self->v[kParamSeq5TransposeInput] - 1;
-    alg->sequencerCVAssignableInput[4] = self->v[kParamSeq5AssignableCVInput] - 1;
-
-    alg->sequencerCVInput[5] = self->v[kParamSeq6CVInput] - 1;
-    alg->sequencerGateInput[5] = self->v[kParamSeq6GateInput] - 1;
-    alg->sequencerResetOutput[5] = self->v[kParamSeq6ResetOutput] - 1;
-    alg->sequencerSelectOutput[5] = self->v[kParamSeq6SeqSelectOutput] - 1;
-    alg->sequencerTransposeInput[5] = self->v[kParamSeq6TransposeInput] - 1;
-    alg->sequencerCVAssignableInput[5] = self->v[kParamSeq6AssignableCVInput] - 1;
-
-    alg->sequencerCVInput[6] = self->v[kParamSeq7CVInput] - 1;
-    alg->sequencerGateInput[6] = self->v[kParamSeq7GateInput] - 1;
-    alg->sequencerResetOutput[6] = self->v[kParamSeq7ResetOutput] - 1;
-    alg->sequencerSelectOutput[6] = self->v[kParamSeq7SeqSelectOutput] - 1;
-    alg->sequencerTransposeInput[6] = self->v[kParamSeq7TransposeInput] - 1;
-    alg->sequencerCVAssignableInput[7] = self->v[kParamSeq7AssignableCVInput] - 1;
-
-    alg->sequencerCVInput[7] = self->v[kParamSeq8CVInput] - 1;
-    alg->sequencerGateInput[7] = self->v[kParamSeq8GateInput] - 1;
-    alg->sequencerResetOutput[7] = self->v[kParamSeq8ResetOutput] - 1;
-    alg->sequencerSelectOutput[7] = self->v[kParamSeq8SeqSelectOutput] - 1;
-    alg->sequencerTransposeInput[7] = self->v[kParamSeq8TransposeInput] - 1;
-    alg->sequencerCVAssignableInput[7] = self->v[kParamSeq8AssignableCVInput] - 1;
-
-    // Get pointers to input and output memory locations
-    float* resetInput = busFrames + resetBusIN * numFrames;
-    float* beatInput = busFrames + beatBusIN * numFrames;
-    float* pitchOutput = busFrames + pitchBusOUT * numFrames;
-    float* gateOutput = busFrames + gateBusOUT * numFrames;
-    float* assignableOutput = busFrames + assignableBusOUT * numFrames;
-
-    int masterStep;
-
-    // Process busFrames
-    for (int frame = 0; frame < numFrames; frame++) {
-
-        // distribute beat input to all 5 sequencers
-        distributeBeatVoltage (beatInput[frame], alg);
-        alg->lastBeatVoltage = beatInput[frame]; // Store last voltage for debugging
-
-        // Process sequencer logic
-        alg->highSeqModule.process();
-
-        // resetInput
-        if (resetInput[frame] > 3.0f) {
-            alg->highSeqModule.reset();    // sends reset to all sequencers
-            alg->triggerFrameCounter = 0;
-            alg->triggerActive = true;
-            //return;
+inline bool beatOverdue (const BeatTracker& beat, int frame) {
+    // no beat by the last frame the tracker would still count as on time (the BEAT_TOLERANCE_SHIFT window
+    // beatIsStable() is built on): the clock has stopped or slowed, and a prediction from it is void
+    int period = beatPeriod(beat);
+    return (beat.lastBeatFrame == NO_BEAT) || (frame - beat.lastBeatFrame > period + (period >> BEAT_TOLERANCE_SHIFT));
+}
+
+inline void recordLatency (uint32_t* histogram, int frames) {
+    // buckets: early (negative), 0, 1, 2, 3, 4..7, 8..15, 16 and up
+    int bucket;
+    if (frames < 0)
+        bucket = 0;
+    else if (frames < 4)
+        bucket = frames + 1;
+    else if (frames < 8)
+        bucket = 5;
+    else if (frames < 16)
+        bucket = 6;
+    else
+        bucket = 7;
+    histogram[bucket] += 1;
+}
+
+void startResetTrigger (SongSequencer* alg, SongLane& lane, BEATSTATE beatState) {
+    // a trigger started ahead of this beat by renderLane() stands for it
+    if (beatState == BEATSTATE::FIRSTHIGH && lane.triggerPredicted) {
+        lane.triggerPredicted = false;
+        return;
+    }
+
+    // Safety check; all step switches might be off
+    int masterStep = lane.highSeqModule.getMasterStep();
+    if (masterStep < 0)
+        return;
+    int sequencer = lane.highSeqModule.steps[masterStep].getAssignedSeq();
+    if (sequencer < 0 || sequencer >= HighSeqModule::NUM_SEQUENCERS)
+        return;
+
+    // Start a new reset trigger only if not already active and reset condition is met
+    if (alg->sequencerResetOutput[sequencer] >= 0 && alg->sequencerResetOutput[sequencer] < NUM_BUSES) {
+        const Sequencer& assigned = lane.highSeqModule.sequencers[sequencer];
+        if (assigned.getResetStatus() == SEQRESET::RESET && !lane.triggerActive &&
+            assigned.getbeatState() == BEATSTATE::FIRSTHIGH) {
+            lane.triggerActive = true;
+            lane.triggerFrameCounter = 0;
+            lane.triggerHandled = true;
+            recordLatency(alg->resetLatency, 0);   // FIRSTHIGH: this is the sequencer's beat frame
         }
+    }
+}
 
-        // Safety check; all step switches might be off
-        masterStep = alg->highSeqModule.getMasterStep();
-        if (masterStep < 0) {
-            gateOutput[frame] = 0.0f;
-            pitchOutput[frame] = 0.0f;
-            //assignableOutput[frame] = 0.0f;
-            continue;
+void processLaneFrame (SongSequencer* alg, SongLane& lane, BEATSTATE beatState, bool resetHigh) {
+    // the per frame sequencing logic; only run on frames where something can change
+    lane.highSeqModule.process();
+
+    // resetInput
+    if (resetHigh) {
+        lane.highSeqModule.reset();    // sends reset to all sequencers
+        lane.triggerFrameCounter = 0;
+        lane.triggerActive = true;
+        lane.triggerPredicted = false;
+    }
+
+    startResetTrigger(alg, lane, beatState);
+}
+
+void followLaneFrame (SongSequencer* alg, SongLane& lane, BEATSTATE beatState, bool resetHigh, int leaderStep) {
+    // follower version of processLaneFrame(): the step comes from the leader, the beat counting is our own
+    lane.highSeqModule.follow(leaderStep);
+
+    if (resetHigh) {
+        lane.highSeqModule.requestSequencerResets();
+        lane.triggerFrameCounter = 0;
+        lane.triggerActive = true;
+        lane.triggerPredicted = false;
+    }
+
+    startResetTrigger(alg, lane, beatState);
+}
+
+bool jumpDue (const SongLane& lane, int quantize, uint8_t beats) {
+    // before the frame is processed: whether the lane's waiting jump goes on this frame. Quantized jumps
+    // wait for the beat of the running step's sequencer (its own input or the shared one)
+    const HighSeqModule& module = lane.highSeqModule;
+    int step = module.getMasterStep();
+    if (quantize == JUMP_IMMEDIATE || step < 0)
+        return true;
+    int sequencer = module.steps[step].getAssignedSeq();
+    if (!(beats & (1 << sequencer)))
+        return false;
+    if (quantize == JUMP_BEAT)
+        return true;
+    const Sequencer& running = module.sequencers[sequencer];
+    return ((running.getbeatCount() + 1) % running.getbeatsPerBar()) == 0;   // this beat starts a bar
+}
+
+void jumpLane (SongLane& lane) {
+    // after the frame is processed: the jump replaces whatever step change the frame made, and starts
+    // a reset trigger for the new step's sequencer so it starts in phase, as the Reset input does
+    lane.highSeqModule.jump(lane.jumpStep);
+    lane.jumpStep = -1;
+    lane.triggerFrameCounter = 0;
+    lane.triggerActive = true;
+    lane.triggerPredicted = false;
+}
+
+inline void fillFrames (float* out, int start, int end, float value) {
+    for (int frame = start; frame < end; frame++)
+        out[frame] = value;
+}
+
+inline void copyFrames (float* out, const float* in, int start, int end) {
+    for (int frame = start; frame < end; frame++)
+        out[frame] = in[frame];
+}
+
+inline void quantizeFrames (float* out, int start, int end, const float* table) {
+    // in place; one table lookup per frame, no branches, so the loop runs the same for every note
+    for (int frame = start; frame < end; frame++) {
+        float volts = fminf(fmaxf(out[frame], -QUANTIZE_RANGE), QUANTIZE_RANGE);
+        int bin = (int) ((volts + QUANTIZE_RANGE) * QUANTIZE_BINS);
+        int octave = bin / QUANTIZE_BINS;
+        out[frame] = (octave - QUANTIZE_RANGE) + table[bin - octave * QUANTIZE_BINS];
+    }
+}
+
+// Bus groups: width consecutive buses from the one a parameter names. Buses are laid out one after the
+// other, so over a whole block a group is a single run of width * numFrames frames and takes one loop
+
+inline int groupWidth (const SongSequencer* alg, int outBus, int inBus) {
+    // voices copied from the group at inBus to the one at outBus (the same bus for a fill); groups stop at the last bus
+    int last = (outBus > inBus) ? outBus : inBus;
+    return (alg->voices < NUM_BUSES - last) ? alg->voices : NUM_BUSES - last;
+}
+
+inline void fillGroup (float* out, int width, int numFrames, int start, int end, float value) {
+    if (start == 0 && end == numFrames) {
+        fillFrames(out, 0, width * numFrames, value);
+        return;
+    }
+    for (int voice = 0; voice < width; voice++)
+        fillFrames(out + voice * numFrames, start, end, value);
+}
+
+inline void copyGroup (float* out, const float* in, int width, int numFrames, int start, int end) {
+    // groups that overlap further up are copied from the top down, so no voice is overwritten before it is read
+    if (out > in && out < in + width * numFrames) {
+        for (int voice = width - 1; voice >= 0; voice--)
+            copyFrames(out + voice * numFrames, in + voice * numFrames, start, end);
+        return;
+    }
+    if (start == 0 && end == numFrames) {
+        copyFrames(out, in, 0, width * numFrames);
+        return;
+    }
+    for (int voice = 0; voice < width; voice++)
+        copyFrames(out + voice * numFrames, in + voice * numFrames, start, end);
+}
+
+inline void quantizeGroup (float* out, int width, int numFrames, int start, int end, const float* table) {
+    if (start == 0 && end == numFrames) {
+        quantizeFrames(out, 0, width * numFrames, table);
+        return;
+    }
+    for (int voice = 0; voice < width; voice++)
+        quantizeFrames(out + voice * numFrames, start, end, table);
+}
+
+inline void rampFrames (float* out, int start, int end, int beatsDone, int beats, float fraction, float fractionPerFrame) {
+    // 0..10V across beats: the beats done, plus the share of the current beat gone, which stops at
+    // the next beat so a late beat holds the ramp rather than overshooting it
+    float voltsPerBeat = 10.0f / beats;
+    float base = beatsDone * voltsPerBeat;
+    float top = fminf(base + voltsPerBeat, 10.0f);
+    for (int frame = start; frame < end; frame++) {
+        out[frame] = fminf(base + fraction * voltsPerBeat, top);
+        fraction += fractionPerFrame;
+    }
+}
+
+void cacheSongPosition (SongLane& lane, bool songChanged) {
+    // worked out here rather than for every stretch renderPosition() draws. nextStartsPass() looks a step
+    // ahead, so it follows the position; songLength() walks a whole pass from the start, so only a change
+    // to the song itself (an edit, modulation or another bank song) moves it
+    if (songChanged)
+        lane.songBeats = lane.highSeqModule.songLength();
+    lane.endsPass = lane.highSeqModule.nextStartsPass();
+}
+
+void renderPosition (SongSequencer* alg, SongLane& lane, float* busFrames, int numFrames, int start, int end) {
+    // step and song ramps, step number and end of song gate. The ramps move from beat to beat with the
+    // tracked beat period, worked out once per stretch; steps on their own beat input step once per beat
+    const HighSeqModule& module = lane.highSeqModule;
+    int masterStep = module.getMasterStep();
+    bool sharedBeat = true;
+    if (masterStep >= 0)
+        sharedBeat = !validBus(alg->sequencerBeatInput[module.steps[masterStep].getAssignedSeq()]);
+    float fraction = 0.f;
+    float fractionPerFrame = 0.f;
+    if (sharedBeat && beatPeriod(alg->beat) > 0 && alg->beat.lastBeatFrame != NO_BEAT) {
+        fractionPerFrame = 1.f / beatPeriod(alg->beat);
+        fraction = (start - alg->beat.lastBeatFrame) * fractionPerFrame;
+    }
+
+    if (validBus(lane.stepRampBusOUT)) {
+        float* out = busFrames + lane.stepRampBusOUT * numFrames;
+        int beats = module.stepLength();
+        if (beats > 0)
+            rampFrames(out, start, end, module.stepPosition(), beats, fraction, fractionPerFrame);
+        else
+            fillFrames(out, start, end, 0.0f);
+    }
+    if (validBus(lane.songRampBusOUT)) {
+        float* out = busFrames + lane.songRampBusOUT * numFrames;
+        int beats = lane.songBeats;
+        if (beats > 0 && masterStep >= 0)
+            rampFrames(out, start, end, ((int) lane.passBeats < beats) ? lane.passBeats : beats, beats, fraction, fractionPerFrame);
+        else
+            fillFrames(out, start, end, 0.0f);
+    }
+    if (validBus(lane.stepCVBusOUT))
+        fillFrames(busFrames + lane.stepCVBusOUT * numFrames, start, end, (float) (masterStep + 1));
+    if (validBus(lane.endGateBusOUT)) {
+        // the beat that ends the song: the next step to come up starts a pass, or the Arrangement ends
+        fillFrames(busFrames + lane.endGateBusOUT * numFrames, start, end, (lane.endsPass && module.stepEnding()) ? 10.0f : 0.0f);
+    }
+}
+
+void renderLane (SongSequencer* alg, SongLane& lane, float* busFrames, int numFrames, int start, int end) {
+    // outputs for frames start..end-1, over which the lane's step and assigned sequencer do not change
+    renderPosition(alg, lane, busFrames, numFrames, start, end);
+    float* pitchOutput = validBus(lane.pitchBusOUT) ? busFrames + lane.pitchBusOUT * numFrames : nullptr;
+    float* gateOutput = validBus(lane.gateBusOUT) ? busFrames + lane.gateBusOUT * numFrames : nullptr;
+    float* assignableOutput = validBus(lane.assignableBusOUT) ? busFrames + lane.assignableBusOUT * numFrames : nullptr;
+
+    // Safety check; all step switches might be off
+    int masterStep = lane.highSeqModule.getMasterStep();
+    int sequencer = (masterStep >= 0) ? lane.highSeqModule.steps[masterStep].getAssignedSeq() : -1;
+    if (sequencer < 0 || sequencer >= HighSeqModule::NUM_SEQUENCERS) {
+        if (gateOutput) fillGroup(gateOutput, groupWidth(alg, lane.gateBusOUT, lane.gateBusOUT), numFrames, start, end, 0.0f);
+        if (pitchOutput) fillGroup(pitchOutput, groupWidth(alg, lane.pitchBusOUT, lane.pitchBusOUT), numFrames, start, end, 0.0f);
+        return;
+    }
+
+    // Predicted reset: with a steady beat, start the trigger resetLead frames before the beat that will
+    // complete the sequencer. Otherwise startResetTrigger() starts it on that beat as before
+    int triggerStart = start;
+    bool overdue = beatOverdue(alg->beat, start);
+    if (overdue)
+        lane.triggerPredicted = false;   // the predicted beat never came, so the next one resets as usual
+    bool sharedBeat = !validBus(alg->sequencerBeatInput[sequencer]);   // predictions only know the shared beat
+    if (alg->resetLead > 0 && sharedBeat && beatIsStable(alg->beat) && !overdue && !lane.triggerActive && !lane.triggerPredicted &&
+        validBus(alg->sequencerResetOutput[sequencer])) {
+        const Sequencer& assigned = lane.highSeqModule.sequencers[sequencer];
+        int triggerFrom = alg->beat.lastBeatFrame + beatPeriod(alg->beat) - alg->resetLead;
+        if (triggerFrom < end && assigned.getResetStatus() == SEQRESET::NORESET &&
+            assigned.getbeatCount() + 1 >= assigned.gettargetBeats()) {
+            lane.triggerActive = true;
+            lane.triggerFrameCounter = 0;
+            lane.triggerHandled = true;
+            lane.triggerPredicted = true;
+            if (triggerFrom > start)
+                triggerStart = triggerFrom;
+            // against the predicted beat, so a trigger started early counts as negative
+            recordLatency(alg->resetLatency, triggerStart - (alg->beat.lastBeatFrame + beatPeriod(alg->beat)));
         }
+    }
 
-        // Find the current sequencer based on the step
-        int sequencer = alg->highSeqModule.steps[masterStep].getAssignedSeq();
-        if (sequencer < 0 || sequencer >= alg->highSeqModule.NUM_SEQUENCERS) {
-            gateOutput[frame] = 0.0f;
-            pitchOutput[frame] = 0.0f;
-            //assignableOutput[frame] = 0.0f;
-            continue;
+    // Reset trigger: high for triggerFramesNeeded frames, written at full level. The reset buses were
+    // cleared once at the start of the block, so lanes sharing a reset bus OR their triggers together:
+    // the bus is high wherever any of them is
+    if (validBus(alg->sequencerResetOutput[sequencer]) && lane.triggerActive) {
+        float* cvOutput = busFrames + alg->sequencerResetOutput[sequencer] * numFrames;
+        int remaining = alg->triggerFramesNeeded - lane.triggerFrameCounter;
+        if (remaining < 1)
+            remaining = 1;
+        int triggerEnd = (end - triggerStart < remaining) ? end : triggerStart + remaining;
+        fillFrames(cvOutput, triggerStart, triggerEnd, 10.0f);
+        lane.triggerFrameCounter += triggerEnd - triggerStart;
+        if (lane.triggerFrameCounter >= alg->triggerFramesNeeded) {
+            lane.triggerFrameCounter = 0;
+            lane.triggerActive = false;
+            lane.triggerHandled = false;
         }
+    }
 
-        // Handle Reset
-        if (alg->sequencerResetOutput[sequencer] >= 0 && alg->sequencerResetOutput[sequencer] < 28) {
-            int seqReset = alg->highSeqModule.sequencers[sequencer].getResetStatus();
-            float* cvOutput = busFrames + alg->sequencerResetOutput[sequencer] * numFrames;
-
-            // Start a new trigger only if not already active and reset condition is met
-            if (seqReset == SEQRESET::RESET  && !alg->triggerActive &&
-                alg->highSeqModule.sequencers[sequencer].getbeatState() == BEATSTATE::FIRSTHIGH) {
-                alg->triggerActive = true;
-                alg->triggerFrameCounter = 0;
-                alg->triggerHandled = true;
-            }
+    // NT Step Sequencer CV Select Output
+    if (validBus(alg->sequencerSelectOutput[sequencer])) {
+        // Calculate the correct parameter index for Seq X ST Seq
+        lane.selectorVoltsOut = songStatic->selectVolts[selectValue(alg, lane, sequencer) - 1];
+        fillFrames(busFrames + alg->sequencerSelectOutput[sequencer] * numFrames, start, end, lane.selectorVoltsOut);
+    }
 
-            // Manage trigger duration
-            if (alg->triggerActive) {
-                alg->triggerFrameCounter += 1;
-                if (alg->triggerFrameCounter >= alg->TRIGGER_FRAMES_NEEDED) {
-                    alg->triggerFrameCounter = 0;
-                    alg->triggerActive = false;
-                    alg->triggerHandled = false;
-                }
-                cvOutput[frame] = 10.0f;
-                } else {
-                    cvOutput[frame] = 0.0f;
+    // St.Seq. lookahead: selectLead frames before the beat predicted to end the step, select the next step's
+    // sequence so the Step Sequencer has it loaded when the reset arrives. Held until the step really changes
+    if (alg->selectLead > 0 && beatPeriod(alg->beat) > 0) {
+        int prefetchFrom = sharedBeat ? alg->beat.lastBeatFrame + beatPeriod(alg->beat) - alg->selectLead : end;
+        if (lane.highSeqModule.steps[masterStep].getRepeatState() == REPEATSTATE::COMPLETE)
+            prefetchFrom = start;   // the step changes on the next frame
+        int nextStep = (prefetchFrom < end) ? lane.highSeqModule.upcomingStep() : -1;
+        if (nextStep >= 0) {
+            int nextSequencer = lane.highSeqModule.steps[nextStep].getAssignedSeq();
+            if (validBus(alg->sequencerSelectOutput[nextSequencer])) {
+                lane.selectorVoltsOut = songStatic->selectVolts[selectValue(alg, lane, nextSequencer) - 1];
+                fillFrames(busFrames + alg->sequencerSelectOutput[nextSequencer] * numFrames,
+                           (prefetchFrom > start) ? prefetchFrom : start, end, lane.selectorVoltsOut);
             }
         }
+    }
 
-        // NT Step Sequencer CV Select Output
-        float* selOutput;
+    // pitch cv input group to pitch output group and transpose (one bus for every voice), then the lane's
+    // quantizer over the whole stretch
+    if (pitchOutput) {
+        int width = groupWidth(alg, lane.pitchBusOUT, lane.pitchBusOUT);
+        if (validBus(alg->sequencerCVInput[sequencer])) {
+            const float* cvInput = busFrames + alg->sequencerCVInput[sequencer] * numFrames;
+            width = groupWidth(alg, lane.pitchBusOUT, alg->sequencerCVInput[sequencer]);
+            if (validBus(alg->sequencerTransposeInput[sequencer])) {
+                const float* transposeInput = busFrames + alg->sequencerTransposeInput[sequencer] * numFrames;
+                for (int voice = 0; voice < width; voice++) {
+                    float* out = pitchOutput + voice * numFrames;
+                    const float* in = cvInput + voice * numFrames;
+                    for (int frame = start; frame < end; frame++)
+                        out[frame] = in[frame] + transposeInput[frame];
+                }
+            } else
+                copyGroup(pitchOutput, cvInput, width, numFrames, start, end);
+            if (lane.quantizeTable)
+                quantizeGroup(pitchOutput, width, numFrames, start, end, lane.quantizeTable);
+        } else
+            fillGroup(pitchOutput, width, numFrames, start, end, 0.0f); // Fallback if bus is invalid
+    }
 
-        if (alg->sequencerSelectOutput[sequencer] >= 0 && alg->sequencerSelectOutput[sequencer] < 28) {
-            // Calculate the correct parameter index for Seq X ST Seq
-            int paramIndex = kParamSeq1SeqSelectValue + (sequencer * 7);
-            alg->selectorVoltsOut = ( alg->v[paramIndex] - 1) * SEQ12THV;
+    // assignable cv input group to assignable cv output group
+    if (assignableOutput) {
+        int assignableBusIN = alg->sequencerCVAssignableInput[sequencer];
+        if (validBus(assignableBusIN))
+            copyGroup(assignableOutput, busFrames + assignableBusIN * numFrames,
+                      groupWidth(alg, lane.assignableBusOUT, assignableBusIN), numFrames, start, end);
+        else
+            fillGroup(assignableOutput, groupWidth(alg, lane.assignableBusOUT, lane.assignableBusOUT), numFrames, start, end, 0.0f); // Fallback if bus is invalid
+    }
 
-            selOutput = busFrames + alg->sequencerSelectOutput[sequencer] * numFrames;
-            selOutput[frame] = alg->selectorVoltsOut;
+    // gate cv input group to gate output group
+    if (gateOutput) {
+        int gateBusIN = alg->sequencerGateInput[sequencer];
+        if (validBus(gateBusIN))
+            copyGroup(gateOutput, busFrames + gateBusIN * numFrames, groupWidth(alg, lane.gateBusOUT, gateBusIN),
+                      numFrames, start, end);
+        else
+            fillGroup(gateOutput, groupWidth(alg, lane.gateBusOUT, lane.gateBusOUT), numFrames, start, end, 0.0f); // fallback if bus is invalid
+    }
+}
+
+
+void traceLaneFrame (SongSequencer* alg, SongLane& lane, int laneIndex, int frame, int stepBefore, int repeatBefore) {
+    // step changes and completed repeat cycles of one processed frame
+    const HighSeqModule& module = lane.highSeqModule;
+    int step = module.getMasterStep();
+    if (stepBefore >= 0 && step == stepBefore && module.steps[step].getCountRepeats() > repeatBefore)
+        alg->trace.write(alg->blockCount, frame, TRACE_REPEAT, laneIndex, step,
+                         module.steps[step].getCountRepeats(), module.steps[step].getRepeats());
+    if (step != stepBefore)
+        alg->trace.write(alg->blockCount, frame, TRACE_STEP, laneIndex, stepBefore, step,
+                         (step >= 0) ? module.steps[step].getAssignedSeq() : -1);
+}
+
+
+void countPassBeats (SongLane& lane, bool beat, bool resetHigh, int stepBefore, int repeatBefore) {
+    // called for every processed frame; a new step visit is a step change, or the same step starting over
+    const HighSeqModule& module = lane.highSeqModule;
+    if (beat && stepBefore >= 0)
+        lane.passBeats += 1;
+    int step = module.getMasterStep();
+    if (resetHigh)
+        lane.passBeats = 0;   // the song starts over
+    else if ((step != stepBefore || (step >= 0 && module.steps[step].getCountRepeats() < repeatBefore)) && module.passStarted())
+        lane.passBeats = 0;
+}
+
+
+#ifdef SONGSEQ_PROFILE
+void measureCycles (SongSequencer* alg, uint32_t cycles, int numFrames) {
+    // worst case first: the peak block, and the peak per frame cost as a block's deadline scales with its frames
+    if (cycles > alg->peakCycles) {
+        alg->peakCycles = cycles;
+        alg->peakFrames = numFrames;
+    }
+    uint32_t perFrame = cycles / numFrames;
+    if (perFrame > alg->peakFrameCycles)
+        alg->peakFrameCycles = perFrame;
+
+    // averages over a window of blocks rather than a running mean, so each figure is what this
+    // instance cost alongside whatever else the preset was running during that window
+    alg->windowCycles += cycles;
+    alg->windowFrames += numFrames;
+    alg->windowBlocks += 1;
+    if (alg->windowBlocks < CYCLE_WINDOW_BLOCKS)
+        return;
+    alg->blockCycles = alg->windowCycles / CYCLE_WINDOW_BLOCKS;
+    alg->frameCycles = alg->windowCycles / alg->windowFrames;
+    alg->windowCycles = 0;
+    alg->windowFrames = 0;
+    alg->windowBlocks = 0;
+}
+#endif
+
+
+void publishSongState (SongSequencer* alg, SongLane& lane) {
+    // called once at the end of each block; gathers everything draw() shows for the running step
+    SongState state;
+    state.blockCount = alg->blockCount;
+    state.steadyBlocks = alg->steadyBlocks;
+#ifdef SONGSEQ_DEBUG
+    state.faultBlocks = alg->faultBlocks;
+    state.faultMask = alg->faultMask;
+#endif
+#ifdef SONGSEQ_PROFILE
+    state.blockCycles = alg->blockCycles;
+    state.frameCycles = alg->frameCycles;
+    state.peakCycles = alg->peakCycles;
+    state.peakFrames = alg->peakFrames;
+    state.peakFrameCycles = alg->peakFrameCycles;
+#endif
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        state.stepLatency[bucket] = alg->stepLatency[bucket];
+        state.resetLatency[bucket] = alg->resetLatency[bucket];
+    }
+    state.masterStep = lane.highSeqModule.getMasterStep();
+    state.assignedSeq = -1;
+    state.beatsPerBar = 0;
+    state.bars = 0;
+    state.beatCount = 0;
+    state.targetBeats = 0;
+    state.repeats = 0;
+    state.countRepeats = 0;
+    state.selectorVolts = lane.selectorVoltsOut;
+    state.songBeats = lane.songBeats;
+    state.stepSwitches = 0;
+    for (int i = 0; i < HighSeqModule::NUM_STEPS; i++) {
+        const MasterStep& step = lane.highSeqModule.steps[i];
+        state.stepSeq[i] = step.getAssignedSeq();
+        state.stepRepeats[i] = step.getRepeats();
+        if (step.getOnOffSwitch())
+            state.stepSwitches |= 1 << i;
+    }
+    state.beatPeriod = beatPeriod(alg->beat);
+    state.beatStable = beatIsStable(alg->beat);
+
+    if (state.masterStep >= 0) {
+        const MasterStep& step = lane.highSeqModule.steps[state.masterStep];
+        state.repeats = step.getRepeats();
+        state.countRepeats = step.getCountRepeats();
+        int seq = step.getAssignedSeq();
+        if (seq >= 0 && seq < HighSeqModule::NUM_SEQUENCERS) {
+            const Sequencer& sequencer = lane.highSeqModule.sequencers[seq];
+            state.assignedSeq = seq;
+            state.beatsPerBar = sequencer.getbeatsPerBar();
+            state.bars = sequencer.getplayBars();
+            state.beatCount = sequencer.getbeatCount();
+            state.targetBeats = sequencer.gettargetBeats();
         }
+    }
+    lane.snapshot.publish(state);
+}
 
-        // pitch cv input to pitch output and transpose
-        float* cvInput; // used for both cv and gate inputs
-        if (alg->sequencerCVInput[sequencer] >= 0 && alg->sequencerCVInput[sequencer] < 28) {
 
-            // get transpose input
-            float transposeInputval = 0.0f;
-            alg->debugVal = alg->sequencerTransposeInput[sequencer];
+void stepSongSequencer(_NT_algorithm* self, float* busFrames, int numFramesBy4) {
+    SongSequencer* alg = static_cast<SongSequencer*>(self);
+#ifdef SONGSEQ_PROFILE
+    uint32_t startCycles = NT_getCpuCycleCount();
+#endif
 
-            if (alg->sequencerTransposeInput[sequencer] >= 0) {
-                cvInput = busFrames + alg->sequencerTransposeInput[sequencer] * numFrames;
-                transposeInputval = cvInput[frame];
-            }
+    int numFrames = numFramesBy4 * 4;
 
-            cvInput = busFrames + alg->sequencerCVInput[sequencer] * numFrames;
-            float pitch = cvInput[frame];
-            pitchOutput[frame] = pitch + transposeInputval;
-        } else {
-            pitchOutput[frame] = 0.0f; // Fallback if bus is invalid
+    int resetBusIN = self->v[kParamResetInput] - 1;
+    int beatBusIN = self->v[kParamBeatInput] - 1;
+
+    // control rate modulation, read once per block: Repeats and Bars CV add one per volt, the Step Mask CV
+    // spreads the 255 masks of steps 1..8 (bit 0 = step 1) over 0..10V, 0V lets every step through
+    int repeatOffset = 0;
+    int barsOffset = 0;
+    unsigned stepMask = ~0u;
+    int repeatsBusIN = self->v[kParamRepeatsCVInput] - 1;
+    int barsBusIN = self->v[kParamBarsCVInput] - 1;
+    int stepMaskBusIN = self->v[kParamStepMaskCVInput] - 1;
+    if (validBus(repeatsBusIN))
+        repeatOffset = (int) roundf(fminf(fmaxf(busFrames[repeatsBusIN * numFrames], -MAX_MODULATION), MAX_MODULATION));
+    if (validBus(barsBusIN))
+        barsOffset = (int) roundf(fminf(fmaxf(busFrames[barsBusIN * numFrames], -MAX_MODULATION), MAX_MODULATION));
+    if (validBus(stepMaskBusIN)) {
+        int mask = (int) roundf(fminf(fmaxf(busFrames[stepMaskBusIN * numFrames], 0.f), 10.f) * STEP_MASKS_PER_VOLT);
+        stepMask = (mask > 0) ? mask : ~0u;
+    }
+
+    takeProgram(alg);
+
+    // Store Song, here rather than in parameterChanged() so the bank is never written while a lane loads it
+    uint32_t stores = alg->storeRequests.exchange(0);
+    for (int song = 1; stores != 0; song++, stores >>= 1) {
+        if (stores & 1)
+            storeSong(alg, song);
+    }
+
+    // Update lane output bus assignments and quantizers
+    for (int lane = 0; lane < alg->numLanes; lane++) {
+        alg->lanes[lane].pitchBusOUT = self->v[laneParam(lane, kLaneParamPitchCVOutput)] - 1;
+        alg->lanes[lane].gateBusOUT = self->v[laneParam(lane, kLaneParamGateOutput)] - 1;
+        alg->lanes[lane].assignableBusOUT = self->v[laneParam(lane, kLaneParamAssignableOutput)] - 1;
+        alg->lanes[lane].stepRampBusOUT = self->v[laneParam(lane, kLaneParamStepRampOutput)] - 1;
+        alg->lanes[lane].songRampBusOUT = self->v[laneParam(lane, kLaneParamSongRampOutput)] - 1;
+        alg->lanes[lane].stepCVBusOUT = self->v[laneParam(lane, kLaneParamStepCVOutput)] - 1;
+        alg->lanes[lane].endGateBusOUT = self->v[laneParam(lane, kLaneParamEndGateOutput)] - 1;
+        alg->lanes[lane].quantizeTable = quantizeTableFor(self->v[laneParam(lane, kLaneParamQuantizeScale)],
+                                                          self->v[laneParam(lane, kLaneParamQuantizeRoot)]);
+        bool playsProgram = (self->v[kParamSyncMode] != SYNC_FOLLOWER) && (alg->program->size() > 0);
+        alg->lanes[lane].highSeqModule.setProgram(playsProgram ? alg->program : nullptr);
+        alg->lanes[lane].highSeqModule.setModulation(repeatOffset, barsOffset, stepMask);
+        alg->lanes[lane].highSeqModule.setOrder(self->v[kParamStepOrder], self->v[kParamOrderSeed]);
+    }
+
+    // Update sequencer input and output bus assignments
+    for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++) {
+        alg->sequencerCVInput[s] = self->v[seqRoutingParam(s, kSeqParamCVInput)] - 1;
+        alg->sequencerGateInput[s] = self->v[seqRoutingParam(s, kSeqParamGateInput)] - 1;
+        alg->sequencerResetOutput[s] = self->v[seqRoutingParam(s, kSeqParamResetOutput)] - 1;
+        alg->sequencerSelectOutput[s] = self->v[seqRoutingParam(s, kSeqParamSelectOutput)] - 1;
+        alg->sequencerTransposeInput[s] = self->v[seqRoutingParam(s, kSeqParamTransposeInput)] - 1;
+        alg->sequencerCVAssignableInput[s] = self->v[seqRoutingParam(s, kSeqParamAssignableCVInput)] - 1;
+        alg->sequencerBeatInput[s] = self->v[kParamSeq1BeatInput + s] - 1;
+    }
+
+    // Reset outputs may be shared between sequencers and lanes: clear each one once per block
+    uint32_t clearedBuses = 0;
+    for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++) {
+        int bus = alg->sequencerResetOutput[s];
+        if (validBus(bus) && !(clearedBuses & (1u << bus))) {
+            fillFrames(busFrames + bus * numFrames, 0, numFrames, 0.0f);
+            clearedBuses |= (1u << bus);
         }
+    }
 
-        // assignable cv input to assignable cv output
-        if (alg->sequencerCVInput[sequencer] >= 0 && alg->sequencerCVInput[sequencer] < 28) {
-            // get assignable CV input
-            cvInput = busFrames + alg->sequencerCVAssignableInput[sequencer] * numFrames;
-            float assignableCVvalue = cvInput[frame];
-            assignableOutput[frame] = assignableCVvalue;
-        } else {
-            assignableOutput[frame] = 0.0f; // Fallback if bus is invalid
+    // Get pointers to input memory locations
+    const float* resetInput = validBus(resetBusIN) ? busFrames + resetBusIN * numFrames : nullptr;
+    const float* beatInput = validBus(beatBusIN) ? busFrames + beatBusIN * numFrames : nullptr;
+
+    // internal clock: Tempo, times 2 per volt on the Tempo CV input (read once per block), as phase per frame
+    float* clockOutput = nullptr;
+    alg->clockIncrement = 0;
+    if (self->v[kParamClockSource] == CLOCK_INTERNAL) {
+        float bpm = self->v[kParamTempo] * 0.1f;
+        int tempoBusIN = self->v[kParamTempoCVInput] - 1;
+        if (validBus(tempoBusIN))
+            bpm *= exp2f(busFrames[tempoBusIN * numFrames]);
+        bpm = fminf(fmaxf(bpm, MIN_MODULATED_TEMPO), MAX_MODULATED_TEMPO);
+        alg->clockIncrement = (uint32_t) (bpm / 60.f / NT_globals.sampleRate * PHASE_PER_CYCLE);
+        int clockBusOUT = self->v[kParamClockOutput] - 1;
+        clockOutput = validBus(clockBusOUT) ? busFrames + clockBusOUT * numFrames : nullptr;
+        beatInput = nullptr;
+    }
+
+    // step jump: the trigger's rising edge picks the step the CV addresses, 1V = step 1 as the Step CV Output
+    int jumpTriggerBusIN = self->v[kParamJumpTriggerInput] - 1;
+    int jumpCVBusIN = self->v[kParamJumpCVInput] - 1;
+    const float* jumpInput = validBus(jumpTriggerBusIN) ? busFrames + jumpTriggerBusIN * numFrames : nullptr;
+    const float* jumpCV = validBus(jumpCVBusIN) ? busFrames + jumpCVBusIN * numFrames : nullptr;
+    int jumpQuantize = self->v[kParamJumpQuantize];
+
+    int syncMode = self->v[kParamSyncMode];
+    SyncSlot& syncSlot = songStatic->syncSlots[self->v[kParamSyncGroup] - 1];
+
+    const SongEvent* events = alg->events;
+    int numEvents = 0;
+    if (syncMode == SYNC_FOLLOWER) {
+        // the leader decoded this block's beat and reset already; nothing new if it has not run since last time
+        if (syncSlot.publishCount != alg->syncPublishSeen) {
+            alg->syncPublishSeen = syncSlot.publishCount;
+            events = syncSlot.entries;
+            numEvents = syncSlot.numEntries;
         }
+    } else
+        numEvents = buildSongEvents(alg, beatInput, resetInput, jumpInput, busFrames, clockOutput, numFrames);
+
+    int numPublished = 0;
+    int publishedStep = -2;
+
+    // St.Seq. lookahead in frames: the larger of the fixed lead and the share of the last beat period
+    alg->selectLead = self->v[kParamSelectLeadFrames];
+    int beatLead = (beatPeriod(alg->beat) * self->v[kParamSelectLeadPercent]) / 100;
+    if (beatLead > alg->selectLead)
+        alg->selectLead = beatLead;
+
+    // predicted reset triggers, ms to frames
+    alg->resetLead = (self->v[kParamResetLead] * (int) NT_globals.sampleRate) / 1000;
+
+    // bank song: the Song CV input when patched (1V per song), otherwise the Song parameter. Lanes change
+    // over at their next step boundary
+    int requestedSong = self->v[kParamSong];
+    int songBusIN = self->v[kParamSongCVInput] - 1;
+    if (validBus(songBusIN))
+        requestedSong = (int) roundf(fmaxf(busFrames[songBusIN * numFrames], 0.f));
+    if (requestedSong > alg->numSongs)
+        requestedSong = alg->numSongs;
+    bool songChanged = (requestedSong != alg->requestedSong);
+    alg->requestedSong = requestedSong;
+
+    // Steady state: no beat edge or reset in the block, no parameter change since the last block and
+    // every lane idle. Frame 0 has nothing to pick up then, so the whole block is one bulk render
+    // (reset triggers in flight are timed by renderLane() in bulk too).
+    bool parametersDirty = alg->parametersDirty;
+    alg->parametersDirty = false;
+    if (parametersDirty && alg->lastEditedParam >= 0) {
+        // only the last edit since the previous block is traced
+        int p = alg->lastEditedParam;
+        alg->trace.write(alg->blockCount, 0, TRACE_PARAM, 0, p & 0xFF, p >> 8, self->v[p] & 0xFF, self->v[p] >> 8);
+    }
+    bool steady = (numEvents == 0 && !parametersDirty && !songChanged);
+    for (int lane = 0; lane < alg->numLanes && steady; lane++) {
+        const HighSeqModule& module = alg->lanes[lane].highSeqModule;
+        steady = (syncMode == SYNC_FOLLOWER) ? !module.hasPendingResets() : module.isIdle();
+    }
+    if (steady)
+        alg->steadyBlocks += 1;
+
+    // position outputs: recache on an edit or a modulation change here, and at step boundaries below
+    bool modulationChanged = (repeatOffset != alg->repeatOffset || barsOffset != alg->barsOffset || stepMask != alg->stepMask);
+    alg->repeatOffset = repeatOffset;
+    alg->barsOffset = barsOffset;
+    alg->stepMask = stepMask;
+    if (parametersDirty || modulationChanged) {
+        for (int lane = 0; lane < alg->numLanes; lane++)
+            cacheSongPosition(alg->lanes[lane], true);
+    }
+
+    // Frames with a beat edge or reset, and the frames after them while any lane still has step, repeat
+    // or sequencer resets pending, run the sequencing logic one frame at a time. Every other stretch of
+    // frames leaves the sequencing state alone, so the outputs are copied across in one go.
+    // Frame 0 runs to pick up parameter changes made between blocks, unless the block is steady.
+    int frame = 0;
+    int nextEvent = 0;
+    bool pending = !steady;
+    while (frame < numFrames) {
+        bool isEvent = (nextEvent < numEvents && events[nextEvent].frame == frame);
+        if (isEvent || pending) {
+            uint8_t flags = 0;
+            uint8_t beats = 0;
+            if (isEvent) {
+                flags = events[nextEvent].flags;
+                beats = events[nextEvent].beats;
+                if (syncMode == SYNC_FOLLOWER)
+                    alg->leaderStep = events[nextEvent].step;
+                nextEvent++;
+            }
+            BEATSTATE beatState = BEATSTATE::LOW;
+            if (flags & EVENT_BEAT) {
+                beatState = BEATSTATE::FIRSTHIGH;
+                trackBeat(alg->beat, frame);
+                int period = (alg->beat.lastPeriod < 0xFFFF) ? alg->beat.lastPeriod : 0xFFFF;
+                alg->trace.write(alg->blockCount, frame, TRACE_BEAT, 0, period & 0xFF, period >> 8);
+            }
+            else if (beatInput && beatInput[frame] >= 3.0f && syncMode != SYNC_FOLLOWER)
+                beatState = BEATSTATE::STILLHIGH;
+            for (int s = 0; beats >> s; s++) {
+                if (beats & (1 << s))
+                    alg->seqBeatFrame[s] = frame;
+            }
+            if ((flags & EVENT_RESET) && !alg->resetWasHigh)
+                alg->trace.write(alg->blockCount, frame, TRACE_RESET, 0);
+            alg->resetWasHigh = (flags & EVENT_RESET) != 0;
+            int jumpTo = -1;
+            if ((flags & EVENT_JUMP) && syncMode != SYNC_FOLLOWER) {
+                jumpTo = jumpCV ? (int) roundf(jumpCV[frame]) - 1 : 0;
+                jumpTo = (jumpTo < 0) ? 0 : (jumpTo >= HighSeqModule::NUM_STEPS) ? HighSeqModule::NUM_STEPS - 1 : jumpTo;
+            }
+
+            pending = false;
+            for (int lane = 0; lane < alg->numLanes; lane++) {
+                SongLane& songLane = alg->lanes[lane];
+                int stepBefore = songLane.highSeqModule.getMasterStep();
+                int repeatBefore = (stepBefore >= 0) ? songLane.highSeqModule.steps[stepBefore].getCountRepeats() : 0;
+                int seqBefore = (stepBefore >= 0) ? songLane.highSeqModule.steps[stepBefore].getAssignedSeq() : -1;
+                bool songDue = (songLane.song != alg->requestedSong) || songLane.songStale;
+                bool boundary = (flags & EVENT_RESET) != 0;
+                bool loaded = false;
+                if (songDue && (stepBefore < 0 || (flags & EVENT_RESET))) {
+                    loadSong(alg, lane, alg->requestedSong);   // nothing playing to cut short
+                    boundary = true;
+                    loaded = true;
+                }
+                distributeBeats(beats, songLane.highSeqModule);
+                if (flags & EVENT_RESET)
+                    songLane.jumpStep = -1;   // a reset drops a jump still waiting on its beat
+                if (jumpTo >= 0)
+                    songLane.jumpStep = jumpTo;
+                bool jumped = (songLane.jumpStep >= 0) && jumpDue(songLane, jumpQuantize, beats);
+                if (syncMode == SYNC_FOLLOWER) {
+                    followLaneFrame(alg, songLane, beatState, (flags & EVENT_RESET) != 0, alg->leaderStep);
+                    if (songLane.highSeqModule.hasPendingResets())
+                        pending = true;
+                } else {
+                    processLaneFrame(alg, songLane, beatState, (flags & EVENT_RESET) != 0);
+                    if (jumped)
+                        jumpLane(songLane);
+                    if (!songLane.highSeqModule.isIdle())
+                        pending = true;
+                }
+                int step = songLane.highSeqModule.getMasterStep();
+                if (songDue && !loaded && step >= 0 && step != stepBefore) {
+                    // a step boundary: the step just started plays from the new song, with its sequencer restarted.
+                    // A step the new song switches off starts the new song from its first step instead
+                    loadSong(alg, lane, alg->requestedSong);
+                    loaded = true;
+                    HighSeqModule& module = songLane.highSeqModule;
+                    if (module.steps[step].getOnOffSwitch() == SWITCHSTATE::ON)
+                        module.sequencers[module.steps[step].getAssignedSeq()].reset();
+                    else
+                        module.reset();
+                    pending = true;
+                }
+                // a new step, a repeat or a jump; the same step starting over counts its repeats again
+                step = songLane.highSeqModule.getMasterStep();
+                if (boundary || jumped || step != stepBefore ||
+                    (step >= 0 && songLane.highSeqModule.steps[step].getCountRepeats() != repeatBefore))
+                    cacheSongPosition(songLane, loaded);
+                countPassBeats(songLane, beatState == BEATSTATE::FIRSTHIGH, (flags & EVENT_RESET) != 0, stepBefore, repeatBefore);
+                // beat driven step change: renderLane() below plays the new sequencer from this frame on. The
+                // beat is the one that ended the old step's sequencer, on its own Beat input or the shared one
+                if (songLane.highSeqModule.getMasterStep() != stepBefore && !(flags & EVENT_RESET) && !jumped &&
+                    seqBefore >= 0 && alg->seqBeatFrame[seqBefore] != NO_BEAT)
+                    recordLatency(alg->stepLatency, frame - alg->seqBeatFrame[seqBefore]);
+                if (alg->trace.enabled())
+                    traceLaneFrame(alg, songLane, lane, frame, stepBefore, repeatBefore);
+                renderLane(alg, songLane, busFrames, numFrames, frame, frame + 1);
+            }
 
-        // gate cv input to gate output
-        if (alg->sequencerGateInput[sequencer] >= 0 && alg->sequencerGateInput[sequencer] < 28) {
-            cvInput = busFrames + alg->sequencerGateInput[sequencer] * numFrames;
-            float gate = cvInput[frame];
-            gateOutput[frame] = gate;
+            // leader: pass on every event and every lane 1 step change, at the frame it happened
+            if (syncMode == SYNC_LEADER) {
+                int step = alg->lanes[0].highSeqModule.getMasterStep();
+                if ((flags || beats || step != publishedStep) && numPublished < alg->maxEvents) {
+                    SongEvent& entry = syncSlot.entries[numPublished++];
+                    entry.frame = frame;
+                    entry.flags = flags;
+                    entry.beats = beats;
+                    entry.step = step;
+                    publishedStep = step;
+                }
+            }
+            frame += 1;
         } else {
-            gateOutput[frame] = 0.0f; // fallback if bus is invalid
+            int end = (nextEvent < numEvents && events[nextEvent].frame < numFrames) ? events[nextEvent].frame : numFrames;
+            for (int lane = 0; lane < alg->numLanes; lane++)
+                renderLane(alg, alg->lanes[lane], busFrames, numFrames, frame, end);
+            alg->resetWasHigh = false;
+            frame = end;
         }
+    }
 
-/*
-        // reset cv input to sequencer reset output
-        if (alg->sequencerResetOutput[sequencer] >= 0 && alg->sequencerResetOutput[sequencer] < 28) {
-            float* cvOutput = busFrames + alg->sequencerResetOutput[sequencer] * numFrames;
-            cvOutput[frame] = resetInput[frame];
-        }
-*/
+    if (syncMode == SYNC_LEADER) {
+        syncSlot.numEntries = numPublished;
+        syncSlot.publishCount = syncSlot.publishCount + 1;
+    }
 
-    } // frame loop
+    advanceBeatTracker(alg->beat, numFrames);
+    for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++) {
+        int beatFrame = alg->seqBeatFrame[s];
+        alg->seqBeatFrame[s] = (beatFrame > NO_BEAT + numFrames) ? beatFrame - numFrames : NO_BEAT;
+    }
+
+    if (beatInput)
+        alg->lastBeatVoltage = beatInput[numFrames - 1]; // Store last voltage for debugging
+
+#ifdef SONGSEQ_DEBUG
+    // debug builds: the sequencing core checks itself once per block; failures only show on the diagnostics
+    // page. Release builds leave this to the host fuzz harness in tools/
+    int failed = 0;
+    for (int lane = 0; lane < alg->numLanes; lane++)
+        failed |= alg->lanes[lane].highSeqModule.checkInvariants();
+    if (failed) {
+        alg->faultBlocks += 1;
+        alg->faultMask |= failed;
+    }
+#endif
+
+    alg->blockCount += 1;
+#ifdef SONGSEQ_PROFILE
+    measureCycles(alg, NT_getCpuCycleCount() - startCycles, numFrames);
+#endif
+    for (int lane = 0; lane < alg->numLanes; lane++)
+        publishSongState (alg, alg->lanes[lane]);
 
 } // step function
 
@@ -749,32 +1992,85 @@ void parameterChanged(_NT_algorithm* self, int p) {
 
     SongSequencer* alg = static_cast<SongSequencer*>(self);
 
-    // Handle sequencer config parameters BEATS PER BAR AND BARS
-    for (int s = 0; s < alg->highSeqModule.NUM_SEQUENCERS; s++) {
-        if (p == kParamSeq1BeatsPerBar + s * PARAMS_PER_SEQUENCER) {
-            alg->highSeqModule.sequencers[s].set_beatsPerBar(self->v[p]);
-        } else if (p == kParamSeq1Bars + s * PARAMS_PER_SEQUENCER) {
-            alg->highSeqModule.sequencers[s].set_bars(self->v[p]);
+    // the next block runs frame 0 through the sequencing logic
+    alg->parametersDirty = true;
+    alg->lastEditedParam = p;
+
+    if (p >= kParamArrangement1 && p <= kParamArrangement12) {
+        compileProgram(alg);
+        return;
+    }
+
+    if (p == kParamStoreSong) {
+        // a one shot: asks the next step() to store, then back to 0 ready for the next
+        int song = self->v[p];
+        if (song > 0 && song <= alg->numSongs) {
+            alg->storeRequests.fetch_or(1u << (song - 1));
+            NT_setParameterFromAudio(NT_algorithmIndex(self), kParamStoreSong + NT_parameterOffset(), 0);
         }
+        return;
     }
 
-    // Handle step config parameters ASSIGNED SEQUENCER AND REPEATS
-    for (int i = 0; i < alg->highSeqModule.NUM_STEPS; i++) {
-        int base = kParamStep1Seq + i * PARAMS_PER_MASTERSTEP;
-        if (p == base) {
-            alg->highSeqModule.steps[i].set_sequencer(self->v[p]);
-        } else if (p == base + 1) {
-            alg->highSeqModule.steps[i].set_repeats(self->v[p]);
-        } else if (p == base + 2) {
-            alg->highSeqModule.steps[i].set_switch(static_cast<SWITCHSTATE>(self->v[p]));
+    // Handle sequencer config parameters BEATS PER BAR AND BARS, shared by all lanes
+    // (lanes playing a bank song take them from the song)
+    for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++) {
+        for (int lane = 0; lane < alg->numLanes; lane++) {
+            if (alg->lanes[lane].storedSong)
+                continue;
+            if (p == seqConfigParam(s, kSeqParamBeatsPerBar)) {
+                alg->lanes[lane].highSeqModule.sequencers[s].set_beatsPerBar(self->v[p]);
+            } else if (p == seqConfigParam(s, kSeqParamBars)) {
+                alg->lanes[lane].highSeqModule.sequencers[s].set_bars(self->v[p]);
+            }
         }
     }
+
+    // Handle step config parameters ASSIGNED SEQUENCER AND REPEATS, lane 1 then lanes 2..
+    int lane = -1;
+    int field = -1;
+    if (p >= kParamStep1Seq && p < kParamSyncMode) {
+        lane = 0;
+        field = kLaneParamStep1Seq + (p - kParamStep1Seq);
+    } else if (p >= kParamLane2Base) {
+        lane = 1 + (p - kParamLane2Base) / kNumLaneParams;
+        field = (p - kParamLane2Base) % kNumLaneParams;
+    }
+    if (lane < 0 || lane >= alg->numLanes || field < kLaneParamStep1Seq || alg->lanes[lane].storedSong)
+        return;
+
+    MasterStep& step = alg->lanes[lane].highSeqModule.steps[(field - kLaneParamStep1Seq) / kNumStepParams];
+    switch ((field - kLaneParamStep1Seq) % kNumStepParams) {
+        case 0:
+            step.set_sequencer(self->v[p]);
+            break;
+        case 1:
+            step.set_repeats(self->v[p]);
+            break;
+        case 2:
+            step.set_switch(static_cast<SWITCHSTATE>(self->v[p]));
+            break;
+    }
+}
+
+
+void midiMessage (_NT_algorithm* self, uint8_t byte0, uint8_t byte1, uint8_t byte2) {
+    // program change on the Song MIDI Channel picks bank song program + 1, through the Song parameter
+    SongSequencer* alg = static_cast<SongSequencer*>(self);
+    int channel = self->v[kParamSongMidiChannel];
+    if (channel == 0 || (byte0 & 0xF0) != 0xC0 || (byte0 & 0x0F) != channel - 1)
+        return;
+    if (byte1 < alg->numSongs)
+        NT_setParameterFromAudio(NT_algorithmIndex(self), kParamSong + NT_parameterOffset(), byte1 + 1);
 }
 
 
 // return controls to be used in the customUI and so overridden
 uint32_t hasCustomUI (_NT_algorithm* self) {
-    return  kNT_encoderL | kNT_encoderR | kNT_potR | kNT_potButtonR;
+    SongSequencer* alg = static_cast<SongSequencer*>(self);
+    uint32_t controls = kNT_encoderL | kNT_encoderR | kNT_potR | kNT_potButtonR | kNT_encoderButtonR;
+    if (alg->numLanes > 1)
+        controls |= kNT_encoderButtonL;   // selects the lane shown in the grid
+    return controls;
 }
 
 
@@ -794,6 +2090,21 @@ void customUI (_NT_algorithm* self, const _NT_uiData& data) {
 
 //  alg->lastUiData = data; // Store UI data for debugging in draw
 
+    // right encoder button - next page: grid, diagnostics, then the trace if there is one
+    if ((data.controls & kNT_encoderButtonR) && !(data.lastButtons & kNT_encoderButtonR)) {
+        if (++alg->uiPage > UIPAGE_TRACE || (alg->uiPage == UIPAGE_TRACE && !alg->trace.enabled()))
+            alg->uiPage = UIPAGE_GRID;
+        alg->traceScroll = 0;
+    }
+
+    // trace page: left encoder scrolls back through the records
+    if (alg->uiPage == UIPAGE_TRACE) {
+        alg->traceScroll -= data.encoders[0];
+        if (alg->traceScroll < 0)
+            alg->traceScroll = 0;
+        return;
+    }
+
     // left encoder - horozontal cursor
     if (data.encoders[0] != 0)
         alg->cell.col += data.encoders[0];
@@ -807,6 +2118,12 @@ void customUI (_NT_algorithm* self, const _NT_uiData& data) {
     if (alg->cell.row < 1) alg->cell.row = 1;
     if (alg->cell.row > 3) alg->cell.row = 3;
 
+    // left encoder button - next lane
+    if ((data.controls & kNT_encoderButtonL) && !(data.lastButtons & kNT_encoderButtonL)) {
+        if (++alg->uiLane >= alg->numLanes)
+            alg->uiLane = 0;
+    }
+
     // toggle edit modes
     if (  (data.controls & kNT_potButtonR)  )
         alg->editMode = true;
@@ -822,17 +2139,17 @@ void customUI (_NT_algorithm* self, const _NT_uiData& data) {
 
     switch (alg->cell.row) {
         case 1:
-            param = kParamStep1Seq + offset;
+            param = laneParam(alg->uiLane, kLaneParamStep1Seq + offset);
             value = round (8 * data.pots[2]);
             NT_setParameterFromUi( NT_algorithmIndex( self ), param + NT_parameterOffset(), value );
             break;
         case 2:
-            param = kParamStep1Repeats + offset;
+            param = laneParam(alg->uiLane, kLaneParamStep1Repeats + offset);
             value = round (16 * data.pots[2]);
             NT_setParameterFromUi( NT_algorithmIndex( self ), param + NT_parameterOffset(), value );
             break;
         case 3:
-            param = kParamStep1Switch + offset;
+            param = laneParam(alg->uiLane, kLaneParamStep1Switch + offset);
             value = round (1 * data.pots[2]);
             NT_setParameterFromUi( NT_algorithmIndex( self ), param + NT_parameterOffset(), value );
         break;
@@ -840,43 +2157,203 @@ void customUI (_NT_algorithm* self, const _NT_uiData& data) {
 }
 
 
+
+void drawDiagnostics (SongSequencer* alg, const SongState& state) {
+    // one tiny line per figure down the left half: label, value, then any detail
+    char buffer[32];
+    int color = 15;
+    int y = 8;
+    int y_offset = 7;
+    int x_value = 40;
+    int x_detail = 90;
+
+    NT_drawText (0, y, "DIAGNOSTICS", color, kNT_textLeft, kNT_textNormal);
+    y += 1;
+
+    y += y_offset;
+    NT_drawText (0, y, "Blocks", color, kNT_textLeft, kNT_textTiny);
+    NT_drawText (x_value, y, digitString(state.blockCount, buffer), color, kNT_textLeft, kNT_textTiny);
+
+    // blocks that needed no per frame processing, and their share of all blocks
+    y += y_offset;
+    NT_drawText (0, y, "Steady", color, kNT_textLeft, kNT_textTiny);
+    NT_drawText (x_value, y, digitString(state.steadyBlocks, buffer), color, kNT_textLeft, kNT_textTiny);
+    if (state.blockCount > 0) {
+        int percent = (int) ((uint64_t) state.steadyBlocks * 100 / state.blockCount);
+        NT_drawText (x_detail, y, digitString(percent, buffer), color, kNT_textLeft, kNT_textTiny);
+        NT_drawText (x_detail + 14, y, "%", color, kNT_textLeft, kNT_textTiny);
+    }
+
+    // beat tracker: period in frames, and whether predictions are being made from it
+    y += y_offset;
+    NT_drawText (0, y, "Beat", color, kNT_textLeft, kNT_textTiny);
+    if (state.beatPeriod > 0) {
+        NT_drawText (x_value, y, digitString(state.beatPeriod, buffer), color, kNT_textLeft, kNT_textTiny);
+        NT_drawText (x_detail, y, state.beatStable ? "stable" : "unstable", color, kNT_textLeft, kNT_textTiny);
+    } else
+        NT_drawText (x_value, y, "--", color, kNT_textLeft, kNT_textTiny);
+
+    // beats in one pass, and Arrangement instructions the last compile left out
+    y += y_offset;
+    NT_drawText (0, y, "Song", color, kNT_textLeft, kNT_textTiny);
+    NT_drawText (x_value, y, digitString(state.songBeats, buffer), color, kNT_textLeft, kNT_textTiny);
+    if (alg->programDropped > 0) {
+        NT_drawText (x_detail, y, "drop", color, kNT_textLeft, kNT_textTiny);
+        NT_drawText (x_detail + 24, y, digitString(alg->programDropped, buffer), color, kNT_textLeft, kNT_textTiny);
+    }
+
+#ifdef SONGSEQ_DEBUG
+    // sequencing invariants: blocks that failed, and which checks (INVARIANT bits)
+    y += y_offset;
+    NT_drawText (0, y, "Faults", color, kNT_textLeft, kNT_textTiny);
+    NT_drawText (x_value, y, digitString(state.faultBlocks, buffer), color, kNT_textLeft, kNT_textTiny);
+    if (state.faultMask) {
+        NT_drawText (x_detail, y, "mask", color, kNT_textLeft, kNT_textTiny);
+        NT_drawText (x_detail + 24, y, digitString(state.faultMask, buffer), color, kNT_textLeft, kNT_textTiny);
+    }
+#endif
+
+#ifdef SONGSEQ_PROFILE
+    // cost of this instance: average cycles per block and per frame
+    y += y_offset;
+    NT_drawText (0, y, "Cycles", color, kNT_textLeft, kNT_textTiny);
+    NT_drawText (x_value, y, digitString(state.blockCycles, buffer), color, kNT_textLeft, kNT_textTiny);
+    NT_drawText (x_detail, y, digitString(state.frameCycles, buffer), color, kNT_textLeft, kNT_textTiny);
+    NT_drawText (x_detail + 24, y, "/f", color, kNT_textLeft, kNT_textTiny);
+#endif
+
+    // and the memory it was given
+    y += y_offset;
+    NT_drawText (0, y, "Memory", color, kNT_textLeft, kNT_textTiny);
+    NT_drawText (x_value, y, digitString(alg->sramBytes, buffer), color, kNT_textLeft, kNT_textTiny);
+    if (alg->dramBytes > 0)
+        NT_drawText (x_detail, y, digitString(alg->dramBytes, buffer), color, kNT_textLeft, kNT_textTiny);
+
+    // worst case, right half: the peak block and its frames, and the peak per frame cost. The host wcet
+    // tool drives the worst cases on purpose and checks them against a ceiling
+    int x_right = 128;
+    y = 16 - y_offset;
+#ifdef SONGSEQ_PROFILE
+    y += y_offset;
+    NT_drawText (x_right, y, "Peak", color, kNT_textLeft, kNT_textTiny);
+    NT_drawText (x_right + x_value, y, digitString(state.peakCycles, buffer), color, kNT_textLeft, kNT_textTiny);
+    NT_drawText (x_right + x_detail, y, digitString(state.peakFrames, buffer), color, kNT_textLeft, kNT_textTiny);
+    NT_drawText (x_right + x_detail + 14, y, "f", color, kNT_textLeft, kNT_textTiny);
+
+    y += y_offset;
+    NT_drawText (x_right, y, "Worst", color, kNT_textLeft, kNT_textTiny);
+    NT_drawText (x_right + x_value, y, digitString(state.peakFrameCycles, buffer), color, kNT_textLeft, kNT_textTiny);
+    NT_drawText (x_right + x_detail, y, "/f", color, kNT_textLeft, kNT_textTiny);
+#endif
+
+    // latency histograms, frames after the beat edge: bucket labels, then one bar per bucket scaled
+    // to the row's fullest bucket, then how many step changes and reset triggers were measured
+    int x_bucket = 11;
+    y += y_offset;
+    NT_drawText (x_right, y, "Latency", color, kNT_textLeft, kNT_textTiny);
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++)
+        NT_drawText (x_right + x_value + bucket * x_bucket, y, latencyLabels[bucket], color, kNT_textLeft, kNT_textTiny);
+
+    const uint32_t* histograms[2] = { state.stepLatency, state.resetLatency };
+    const char* const names[2] = { "Step", "Reset" };
+    uint32_t totals[2] = { 0, 0 };
+    for (int row = 0; row < 2; row++) {
+        y += y_offset;
+        NT_drawText (x_right, y, names[row], color, kNT_textLeft, kNT_textTiny);
+        uint32_t fullest = 0;
+        for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+            totals[row] += histograms[row][bucket];
+            if (histograms[row][bucket] > fullest)
+                fullest = histograms[row][bucket];
+        }
+        for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+            if (histograms[row][bucket] == 0)
+                continue;
+            int height = 1 + (int) ((uint64_t) histograms[row][bucket] * (y_offset - 2) / fullest);
+            int x = x_right + x_value + bucket * x_bucket;
+            NT_drawShapeI (kNT_rectangle, x, y - height + 1, x + x_bucket - 3, y, color);
+        }
+    }
+
+    y += y_offset;
+    NT_drawText (x_right, y, "Count", color, kNT_textLeft, kNT_textTiny);
+    NT_drawText (x_right + x_value, y, digitString(totals[0], buffer), color, kNT_textLeft, kNT_textTiny);
+    NT_drawText (x_right + x_detail, y, digitString(totals[1], buffer), color, kNT_textLeft, kNT_textTiny);
+}
+
+
+void drawTrace (SongSequencer* alg) {
+    // newest records at the bottom; the left encoder scrolls back
+    char buffer[48];
+    int color = 15;
+    int y = 10;
+
+    uint32_t written = alg->trace.written();
+    NT_drawText (0, y, "TRACE", color, kNT_textLeft, kNT_textNormal);
+    NT_drawText (80, y, digitString(written, buffer), color, kNT_textLeft, kNT_textNormal);
+    if (alg->traceScroll > 0) {
+        NT_drawText (160, y, "-", color, kNT_textLeft, kNT_textNormal);
+        NT_drawText (166, y, digitString(alg->traceScroll, buffer), color, kNT_textLeft, kNT_textNormal);
+    }
+
+    y += 4;
+    for (int line = TRACE_PAGE_LINES; line >= 1; line--) {
+        y += 7;
+        uint32_t back = alg->traceScroll + line;
+        TraceRecord record;
+        if (back > written || !alg->trace.read(written - back, record))
+            continue;
+        TraceBuffer::format(record, buffer);
+        NT_drawText (0, y, buffer, color, kNT_textLeft, kNT_textTiny);
+    }
+}
+
+
 bool drawSongSequencer (_NT_algorithm* self) {
-    const SongSequencer* alg = static_cast<const SongSequencer*>(self);
+    SongSequencer* alg = static_cast<SongSequencer*>(self);
     char buffer[32];
     _cursor cursor;
 
-    assignSequencerParameters (self);
     int color = 15;
 
+    // the grid shows the lane selected with the left encoder button. Everything drawn comes from its
+    // snapshot, as the module itself belongs to step() and parameterChanged().
+    // Take a consistent copy of the running state; keep the previous one if step() kept overlapping the read
+    alg->lanes[alg->uiLane].snapshot.read(alg->displayState);
+    const SongState& state = alg->displayState;
+
+    if (alg->uiPage == UIPAGE_DIAGNOSTICS) {
+        drawDiagnostics(alg, state);
+        return true;
+    }
+    if (alg->uiPage == UIPAGE_TRACE) {
+        drawTrace(alg);
+        return true;
+    }
+
     // LINE ONE - Basic Info
     int y = 10;
     int y_offset = 11;
-    int masterStep = alg->highSeqModule.getMasterStep();
-    int assignedSeq = -1;
-
-    if (masterStep >= 0)
-        assignedSeq = alg->highSeqModule.steps[masterStep].getAssignedSeq();
+    int masterStep = state.masterStep;
+    int assignedSeq = state.assignedSeq;
 
     // LINE ONE - overall highSeqModule State
 
     // LINE ONE - Bars/Beats per Bar for active sequencer
     NT_drawText (0, y, "Bars/Bpb" , color, kNT_textLeft, kNT_textNormal);
     if (masterStep >= 0) {
-        if (assignedSeq >= 0 && assignedSeq < alg->highSeqModule.NUM_SEQUENCERS) {
+        if (assignedSeq >= 0 && assignedSeq < HighSeqModule::NUM_SEQUENCERS) {
             // Bars
-            NT_intToString(buffer, alg->highSeqModule.sequencers[assignedSeq].getbars());
-            NT_drawText(58, y, buffer, color, kNT_textLeft, kNT_textNormal);
+            NT_drawText(58, y, digitString(state.bars, buffer), color, kNT_textLeft, kNT_textNormal);
 
-            if (alg->highSeqModule.sequencers[assignedSeq].getbars() < 10) {
+            if (state.bars < 10) {
                 NT_drawText(65, y, "/", color, kNT_textLeft, kNT_textNormal);
                 // Beats per bar
-                NT_intToString(buffer, alg->highSeqModule.sequencers[assignedSeq].getbeatsPerBar());
-                NT_drawText(71, y, buffer, color, kNT_textLeft, kNT_textNormal);
+                NT_drawText(71, y, digitString(state.beatsPerBar, buffer), color, kNT_textLeft, kNT_textNormal);
             } else {
                 NT_drawText(71, y, "/", color, kNT_textLeft, kNT_textNormal);
                 // Beats per bar
-                NT_intToString(buffer, alg->highSeqModule.sequencers[assignedSeq].getbeatsPerBar());
-                NT_drawText(77, y, buffer, color, kNT_textLeft, kNT_textNormal);
+                NT_drawText(77, y, digitString(state.beatsPerBar, buffer), color, kNT_textLeft, kNT_textNormal);
             }
 
         }
@@ -889,9 +2366,8 @@ bool drawSongSequencer (_NT_algorithm* self) {
     // LINE ONE - Repeat countfor active sequencer
     NT_drawText (96, y, "Rep" , color, kNT_textLeft, kNT_textNormal);
     if (masterStep >= 0) {
-        if (assignedSeq >= 0 && assignedSeq < alg->highSeqModule.NUM_SEQUENCERS) {
-            NT_intToString(buffer, alg->highSeqModule.steps[masterStep].getCountRepeats());
-            NT_drawText(122, y, buffer, color, kNT_textLeft, kNT_textNormal);
+        if (assignedSeq >= 0 && assignedSeq < HighSeqModule::NUM_SEQUENCERS) {
+            NT_drawText(122, y, digitString(state.countRepeats, buffer), color, kNT_textLeft, kNT_textNormal);
         }
         else NT_drawText(122, y, "--", color, kNT_textLeft, kNT_textTiny);
     }
@@ -901,12 +2377,10 @@ bool drawSongSequencer (_NT_algorithm* self) {
     // LINE ONE - Current Bar
     NT_drawText (141, y, "Bar", color, kNT_textLeft, kNT_textNormal);
     if (masterStep >= 0) {
-        if (assignedSeq >= 0 && assignedSeq < alg->highSeqModule.NUM_SEQUENCERS) {
+        if (assignedSeq >= 0 && assignedSeq < HighSeqModule::NUM_SEQUENCERS) {
             // bar = floor (current beat / beats per bar + 1
-            int bar = floor(alg->highSeqModule.sequencers[assignedSeq].getbeatCount() /
-                            alg->highSeqModule.sequencers[assignedSeq].getbeatsPerBar()) + 1;
-            NT_intToString(buffer, bar);
-            NT_drawText(167, y, buffer, color, kNT_textLeft, kNT_textNormal);
+            int bar = floor(state.beatCount / state.beatsPerBar) + 1;
+            NT_drawText(167, y, digitString(bar, buffer), color, kNT_textLeft, kNT_textNormal);
         }
         else NT_drawText(167, y, "--", color, kNT_textLeft, kNT_textTiny);
     }
@@ -917,11 +2391,9 @@ bool drawSongSequencer (_NT_algorithm* self) {
     // LINE ONE - Beatcount for active sequencer
     NT_drawText (186, y, "Beat", color, kNT_textLeft, kNT_textNormal);
     if (masterStep >= 0) {
-        if (assignedSeq >= 0 && assignedSeq < alg->highSeqModule.NUM_SEQUENCERS) {
-           int beat = 1 + floor(alg->highSeqModule.sequencers[assignedSeq].getbeatCount() %
-                      alg->highSeqModule.sequencers[assignedSeq].getbeatsPerBar());
-           NT_intToString(buffer, beat);
-           NT_drawText(218, y, buffer, color, kNT_textLeft, kNT_textNormal);
+        if (assignedSeq >= 0 && assignedSeq < HighSeqModule::NUM_SEQUENCERS) {
+           int beat = 1 + floor(state.beatCount % state.beatsPerBar);
+           NT_drawText(218, y, digitString(beat, buffer), color, kNT_textLeft, kNT_textNormal);
         }
         else
            NT_drawText(218, y, "--", color, kNT_textLeft, kNT_textTiny);
@@ -934,7 +2406,7 @@ bool drawSongSequencer (_NT_algorithm* self) {
     //float testVal = alg->v[kParamSeq1SeqSelectValue + sequencer + NT_parameterOffset()];
     //float testVal = alg->v[kParamSeq1SeqSelectValue + assignedSeq];
     //NT_floatToString(buffer, testVal);
-    NT_floatToString(buffer, alg->selectorVoltsOut);
+    NT_floatToString(buffer, state.selectorVolts);
     NT_drawText (230, y, buffer, color, kNT_textLeft, kNT_textNormal);
 
 
@@ -962,9 +2434,12 @@ bool drawSongSequencer (_NT_algorithm* self) {
     y += y_offset + 5;
     NT_drawShapeI(kNT_rectangle, 1, y-y_offset, 256, y, 3 );
     //NT_drawText (1, y, "STEP", 15, kNT_textLeft, kNT_textNormal);
-    for (int step = 0; step < alg->highSeqModule.NUM_STEPS; step++) {
-        NT_intToString(buffer, step+1);
-        NT_drawText (x_offset * (step+1), y - 2, buffer, color, kNT_textLeft, kNT_textNormal);
+    if (alg->numLanes > 1) {
+        NT_drawText (1, y - 2, "L", color, kNT_textLeft, kNT_textNormal);
+        NT_drawText (7, y - 2, digitString(alg->uiLane + 1, buffer), color, kNT_textLeft, kNT_textNormal);
+    }
+    for (int step = 0; step < HighSeqModule::NUM_STEPS; step++) {
+        NT_drawText (x_offset * (step+1), y - 2, digitString(step+1, buffer), color, kNT_textLeft, kNT_textNormal);
         if (step == masterStep)
             NT_drawShapeI (kNT_circle, x_offset * (step+1) + 2, y-5, 6, 6);
             //NT_drawShapeI (kNT_box, x_offset * (step+1) + 2, y-5, 6, 6);
@@ -973,38 +2448,34 @@ bool drawSongSequencer (_NT_algorithm* self) {
     // LINE THREE - Assigned Sequencer
     y += y_offset;
     NT_drawText (1, y, "SEQ ", color, kNT_textLeft, kNT_textNormal);
-    char labels[] = "ABCDEFGH";
-    for (int step = 0; step < alg->highSeqModule.NUM_STEPS; step++) {
-        int seq = alg->highSeqModule.steps[step].getAssignedSeq();
-        buffer[0] = labels[seq];
-        NT_drawText (x_offset * (step+1), y, buffer, color, kNT_textLeft, kNT_textNormal);
+    for (int step = 0; step < HighSeqModule::NUM_STEPS; step++) {
+        int seq = state.stepSeq[step];
+        NT_drawText (x_offset * (step+1), y, songStatic->seqLabels[seq], color, kNT_textLeft, kNT_textNormal);
     }
 
     // LINE FOUR - Repeats
     y += y_offset;
     NT_drawText (1, y, "REP ", color, kNT_textLeft, kNT_textNormal);
-    for (int step = 0; step < alg->highSeqModule.NUM_STEPS; step++) {
-        int repeats = alg->highSeqModule.steps[step].getRepeats();
-        NT_intToString(buffer, repeats);
-        NT_drawText (x_offset * (step+1), y, buffer, color, kNT_textLeft, kNT_textNormal);
+    for (int step = 0; step < HighSeqModule::NUM_STEPS; step++) {
+        int repeats = state.stepRepeats[step];
+        NT_drawText (x_offset * (step+1), y, digitString(repeats, buffer), color, kNT_textLeft, kNT_textNormal);
     }
 
 /*
     // LINE FIVE - Current Repeat Count
     y += y_offset;
     NT_drawText (1, y, "REP#", color, kNT_textLeft, kNT_textNormal);
-    for (int step = 0; step < alg->highSeqModule.NUM_STEPS; step++) {
-        int countRepeats = alg->highSeqModule.steps[step].getCountRepeats();
-        NT_intToString(buffer, countRepeats);
-        NT_drawText (x_offset * (step+1), y, buffer, 3, kNT_textLeft, kNT_textNormal);
+    for (int step = 0; step < HighSeqModule::NUM_STEPS; step++) {
+        int countRepeats = module.steps[step].getCountRepeats();
+        NT_drawText (x_offset * (step+1), y, digitString(countRepeats, buffer), 3, kNT_textLeft, kNT_textNormal);
     }
 */
 
     // LINE SIX - Switch State
     y += y_offset;
     NT_drawText (1, y, "On", color, kNT_textLeft, kNT_textNormal);
-    for (int step = 0; step < alg->highSeqModule.NUM_STEPS; step++) {
-        if (alg->highSeqModule.steps[step].getOnOffSwitch()) {
+    for (int step = 0; step < HighSeqModule::NUM_STEPS; step++) {
+        if (state.stepSwitches & (1 << step)) {
             NT_drawText (x_offset * (step+1), y, "Y", color, kNT_textLeft, kNT_textNormal);
         } else {
             NT_drawText (x_offset * (step+1), y, "-", color, kNT_textLeft, kNT_textNormal);
@@ -1024,16 +2495,59 @@ bool drawSongSequencer (_NT_algorithm* self) {
 }
 
 void calculateStaticRequirementsSongSequencer(_NT_staticRequirements& req) {
-    req.dram = 0; // No static DRAM needed
+    req.dram = sizeof(SongSequencerStatic) + NUM_SYNC_GROUPS * NT_globals.maxFramesPerStep * sizeof(SongEvent);
+}
+
+void initialiseSongSequencer(_NT_staticMemoryPtrs& ptrs, const _NT_staticRequirements& req) {
+    songStatic = new (static_cast<void*>(ptrs.dram)) SongSequencerStatic;
+
+    for (int i = 0; i < NUM_ST_SEQUENCES; i++)
+        songStatic->selectVolts[i] = i * SEQ12THV;
+
+    for (unsigned int i = 0; i < ARRAY_SIZE(knownSampleRates); i++)
+        songStatic->triggerFrames[i] = calcTriggerFrames(knownSampleRates[i]);
+
+    for (int i = 0; i <= MAX_DIGIT_STRING; i++)
+        NT_intToString(songStatic->digits[i], i);
+
+    for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++) {
+        songStatic->seqLabels[s][0] = 'A' + s;
+        songStatic->seqLabels[s][1] = 0;
+    }
+
+    for (int scale = 0; scale < NUM_SCALES; scale++) {
+        for (int root = 0; root < SEMITONES; root++)
+            buildQuantizeTable(songStatic->quantizeTables[scale][root], scaleMasks[scale], root);
+    }
+
+    // sync slots: nothing published yet
+    SongEvent* entries = reinterpret_cast<SongEvent*>(ptrs.dram + sizeof(SongSequencerStatic));
+    for (int group = 0; group < NUM_SYNC_GROUPS; group++) {
+        songStatic->syncSlots[group].publishCount = 0;
+        songStatic->syncSlots[group].numEntries = 0;
+        songStatic->syncSlots[group].entries = entries + group * NT_globals.maxFramesPerStep;
+    }
+
+    // parameter pages: the fixed pages, then one page per extra lane
+    for (int page = 0; page < NUM_FIXED_PAGES; page++)
+        songStatic->pages[page] = songSequencerParameterPages[page];
+    for (int lane = 1; lane < MAX_LANES; lane++) {
+        for (int field = 0; field < kNumLaneParams; field++)
+            songStatic->lanePageParams[lane - 1][field] = laneParam(lane, field);
+        _NT_parameterPage& page = songStatic->pages[NUM_FIXED_PAGES + lane - 1];
+        page.name = lanePageNames[lane - 1];
+        page.numParams = kNumLaneParams;
+        page.params = songStatic->lanePageParams[lane - 1];
+    }
 }
 
 void calculateRequirementsSongSequencer(_NT_algorithmRequirements& req, const int32_t* specifications) {
-    req.numParameters = ARRAY_SIZE(songSequencerParameters);
-    req.sram = sizeof(SongSequencer);
+    req.numParameters = numParametersForLanes(specifications[kSpecLanes]);
+    req.sram = songSequencerSramSize(specifications[kSpecLanes]);
 
     // req.dram = 28 * 128 * sizeof(float); // Support 28 buses, assume 128 frames per block
     //req.dram = 28 * 128 * sizeof(float); // Support 28 buses, assume 128 frames per block
-    req.dram = 0;
+    req.dram = traceBytes(specifications) + songBankBytes(specifications) + 2 * sizeof(SongProgram);
 
     req.dtc = 0;
     req.itc = 0;
@@ -1046,21 +2560,35 @@ void calculateRequirementsSongSequencer(_NT_algorithmRequirements& req, const in
     */
 }
 
+#ifdef SONGSEQ_HOST
+// Host tools only (tools/Makefile builds the plugin with SONGSEQ_HOST): what the NT itself cannot show
+// off the module, read through the algorithm the factory built
+const TraceBuffer& songSequencerTrace (const _NT_algorithm* self) {
+    return static_cast<const SongSequencer*>(self)->trace;
+}
+
+bool songSequencerLaneState (const _NT_algorithm* self, int lane, SongState& state) {
+    // the snapshot the display reads; false for a lane the instance does not have
+    const SongSequencer* alg = static_cast<const SongSequencer*>(self);
+    return (lane >= 0) && (lane < alg->numLanes) && alg->lanes[lane].snapshot.read(state);
+}
+#endif
+
 static const _NT_factory songSequencerFactory = {
     NT_MULTICHAR('C', 'L', 'C', '2'),  // guid
     "Song Sequencer", // name
     "A Sequencer Sequencer",  // descr
-    0, // number of specifications
-    nullptr, // specifications
+    ARRAY_SIZE(songSequencerSpecifications), // number of specifications
+    songSequencerSpecifications, // specifications
     calculateStaticRequirementsSongSequencer,  // static requirements
-    nullptr,  // initialise static memory
+    initialiseSongSequencer,  // initialise static memory
     calculateRequirementsSongSequencer,  // dynamic requirements
     constructSongSequencer,  // constructor
     parameterChanged,
     stepSongSequencer, // step function
     drawSongSequencer, // draw function
     nullptr, // midirealtime
-    nullptr, // midi message
+    midiMessage, // midi message
     kNT_tagUtility, // NT tags
     hasCustomUI, // hasCustomUi
     customUI, // customUI
@@ -0,0 +1,91 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+namespace CLC_Synths {
+
+	static const int LATENCY_BUCKETS = 8;   // early, 0, 1, 2, 3, 4..7, 8..15, 16+ frames
+	static const int STATE_STEPS = 8;       // HighSeqModule::NUM_STEPS, for the grid
+
+	// Copy of the sequencing state that the display (and any other non-audio consumer) is allowed to see
+	struct SongState {
+		uint32_t blockCount;   // audio blocks processed since construction
+		uint32_t steadyBlocks; // blocks that took the steady state fast path
+		int masterStep;        // -1 when no step is running
+		int assignedSeq;       // -1 when no step is running
+		int beatsPerBar;
+		int bars;
+		int beatCount;
+		int targetBeats;
+		int repeats;
+		int countRepeats;
+		float selectorVolts;   // last NT Step Sequencer select voltage sent
+		int songBeats;         // beats in one pass of the song, 0 if no step is on
+		int8_t stepSeq[STATE_STEPS];     // the lane's grid: assigned sequencer,
+		int8_t stepRepeats[STATE_STEPS]; // repeats with the Repeat Offset applied,
+		uint8_t stepSwitches;            // and bit i set when step i is on
+		int beatPeriod;        // tracked beat period in frames, 0 until known
+		bool beatStable;       // beat period steady enough to predict the next beat
+#ifdef SONGSEQ_DEBUG
+		uint32_t faultBlocks;  // blocks that ended with a sequencing invariant broken
+		int faultMask;         // INVARIANT bits seen so far
+#endif
+#ifdef SONGSEQ_PROFILE
+		uint32_t blockCycles;  // average cycles per block over the last measuring window
+		uint32_t frameCycles;  // the same per frame
+		uint32_t peakCycles;   // most cycles one block took
+		int peakFrames;        // frames in that block
+		uint32_t peakFrameCycles; // most cycles per frame of any block
+#endif
+		uint32_t stepLatency[LATENCY_BUCKETS];  // beat edge to the first frame of a new step, in frames
+		uint32_t resetLatency[LATENCY_BUCKETS]; // beat edge to the start of its reset trigger
+	};
+
+	// Single writer seqlock. The audio thread publishes once per block and never waits;
+	// a reader copies the state and only accepts it if no publish overlapped the copy.
+	// Defined inline, as TraceBuffer, for the host tools that link the plugin
+	class StateSnapshot {
+	public:
+		static const int MAX_READ_ATTEMPTS = 4;  // audio preempts at most once per block, so a retry or two is plenty
+	private:
+		volatile uint32_t version;   // odd while a publish is in progress
+		SongState state;
+	public:
+		StateSnapshot();
+		void publish(const SongState& p_state);
+		bool read(SongState& p_state) const;
+	};
+
+	inline StateSnapshot::StateSnapshot() {
+		version = 0;
+		state = SongState();
+		state.masterStep = -1;
+		state.assignedSeq = -1;
+	}
+
+	inline void StateSnapshot::publish(const SongState& p_state) {
+		// writer side: bump to odd, copy, bump to even. Never blocks or retries.
+		version = version + 1;
+		std::atomic_thread_fence(std::memory_order_release);
+		state = p_state;
+		std::atomic_thread_fence(std::memory_order_release);
+		version = version + 1;
+	}
+
+	inline bool StateSnapshot::read(SongState& p_state) const {
+		// reader side: returns false if every attempt overlapped a publish, p_state is then left untouched
+		for (int attempt = 0; attempt < MAX_READ_ATTEMPTS; attempt++) {
+			uint32_t before = version;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (before & 1)
+				continue;
+			SongState copy = state;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (version == before) {
+				p_state = copy;
+				return true;
+			}
+		}
+		return false;
+	}
+} // namespace
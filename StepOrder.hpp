@@ -0,0 +1,144 @@
+#pragma once
+#include <stdint.h>
+
+namespace CLC_Synths {
+
+	// Values of the Step Order parameter
+	enum STEPORDER {
+		ORDER_FORWARD = 0,      // 1..8, round and round
+		ORDER_REVERSE,          // 8..1
+		ORDER_PINGPONG,         // 1..8..2, the end steps once per pass
+		ORDER_RANDOM,           // every step on once per pass in a shuffled order, never the same step twice running
+	};
+
+	// The steps one pass plays, in order. Rebuilt from the switch mask only when the switches, the mode or
+	// the seed change, and for Random when a pass ends, so moving on at a step boundary is one table index
+	class StepOrder {
+	public:
+		static const int MAX_STEPS = 8;
+		static const int MAX_LENGTH = 2 * MAX_STEPS - 2;   // ping-pong over every step
+	private:
+		int8_t table[MAX_LENGTH];
+		uint8_t length;
+		int8_t nextFirst;        // first step of the pass after this one
+		unsigned mask;           // switch mask the table was built from, ~0 before the first build
+		uint8_t mode;
+		uint32_t seed;
+		uint32_t pass;           // Random: the pass the table holds
+		void fill();
+	public:
+		StepOrder() : length(0), nextFirst(-1), mask(~0u), mode(ORDER_FORWARD), seed(0), pass(0) {}
+		bool builtFor(unsigned p_mask, int p_mode, uint32_t p_seed) const;
+		void build(unsigned p_mask, int p_mode, uint32_t p_seed, uint32_t p_pass);
+		void seek(uint32_t p_pass);
+		uint32_t getPass() const { return pass; }
+		int size() const { return length; }
+		int at(int position) const { return table[position]; }
+		int firstOfNextPass() const { return nextFirst; }
+		int find(int step) const;
+		int resume(int step) const;
+	};
+
+	static uint32_t orderHash(uint32_t seed, uint32_t pass, uint32_t index) {
+		// counter based: the same seed, pass and index always give the same number, in any order asked
+		uint32_t x = (seed * 0x9E3779B9u) ^ (pass * 0x85EBCA6Bu) ^ (index * 0xC2B2AE35u);
+		x ^= x >> 16;
+		x *= 0x7FEB352Du;
+		x ^= x >> 15;
+		x *= 0x846CA68Bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+	static void orderShuffle(int8_t* out, const int8_t* steps, int count, uint32_t seed, uint32_t pass) {
+		// Fisher-Yates over the steps switched on, drawing from orderHash() instead of a running generator
+		for (int i = 0; i < count; i++)
+			out[i] = steps[i];
+		for (int i = count - 1; i > 0; i--) {
+			int j = orderHash(seed, pass, i) % (i + 1);
+			int8_t swap = out[i];
+			out[i] = out[j];
+			out[j] = swap;
+		}
+	}
+
+	bool StepOrder::builtFor(unsigned p_mask, int p_mode, uint32_t p_seed) const {
+		return (mask == p_mask) && (mode == p_mode) && ((mode != ORDER_RANDOM) || (seed == p_seed));
+	}
+
+	void StepOrder::build(unsigned p_mask, int p_mode, uint32_t p_seed, uint32_t p_pass) {
+		mask = p_mask;
+		mode = p_mode;
+		seed = p_seed;
+		pass = p_pass;
+		fill();
+	}
+
+	void StepOrder::seek(uint32_t p_pass) {
+		// the order of any pass, without playing the ones before it; only Random changes from pass to pass
+		pass = p_pass;
+		if (mode == ORDER_RANDOM)
+			fill();
+	}
+
+	void StepOrder::fill() {
+		int8_t on[MAX_STEPS];
+		int count = 0;
+		for (int step = 0; step < MAX_STEPS; step++) {
+			if (mask & (1u << step))
+				on[count++] = step;
+		}
+		length = 0;
+		if (mode == ORDER_RANDOM && count >= 3) {
+			// a pass never starts with the step the one before ended on. Only the first two entries swap,
+			// so the last step of a pass, and with it every pass, follows from the seed and pass number alone
+			int8_t other[MAX_STEPS];
+			orderShuffle(table, on, count, seed, pass);
+			length = count;
+			if (pass > 0) {
+				orderShuffle(other, on, count, seed, pass - 1);
+				if (table[0] == other[count - 1]) {
+					table[0] = table[1];
+					table[1] = other[count - 1];
+				}
+			}
+			orderShuffle(other, on, count, seed, pass + 1);
+			nextFirst = (other[0] == table[count - 1]) ? other[1] : other[0];
+			return;
+		}
+		if (mode == ORDER_REVERSE) {
+			for (int i = count - 1; i >= 0; i--)
+				table[length++] = on[i];
+		} else {
+			// Forward, Ping-Pong, and Random with fewer than 3 steps, which can only take turns
+			for (int i = 0; i < count; i++)
+				table[length++] = on[i];
+			if (mode == ORDER_PINGPONG) {
+				for (int i = count - 2; i > 0; i--)
+					table[length++] = on[i];
+			}
+		}
+		nextFirst = (length > 0) ? table[0] : -1;
+	}
+
+	int StepOrder::find(int step) const {
+		// first position of step in the table, -1 if it is switched off
+		for (int position = 0; position < length; position++) {
+			if (table[position] == step)
+				return position;
+		}
+		return -1;
+	}
+
+	int StepOrder::resume(int step) const {
+		// for a step no longer in the table: the position to carry on from, so the next step played is
+		// the first one on after it in the direction of play (downwards in Reverse). -1 if none is on
+		int direction = (mode == ORDER_REVERSE) ? MAX_STEPS - 1 : 1;
+		for (int k = 1; k <= MAX_STEPS; k++) {
+			int position = find((step + k * direction) % MAX_STEPS);
+			if (position >= 0)
+				return (position + length - 1) % length;
+		}
+		return -1;
+	}
+} // namespace
@@ -0,0 +1,152 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+namespace CLC_Synths {
+
+	enum TRACETYPE {
+		TRACE_BEAT = 1,     // payload: beat period in frames (16 bit)
+		TRACE_RESET,        // reset input went high
+		TRACE_STEP,         // payload: old step, new step, assigned sequencer (-1 = none)
+		TRACE_REPEAT,       // payload: step, repeat count, repeats
+		TRACE_PARAM,        // payload: parameter index (16 bit), value (16 bit)
+	};
+
+	// Fixed size binary record; the layout is what a host decoder reads back
+	struct TraceRecord {
+		uint32_t block;     // audio block counter
+		uint16_t frame;     // frame within the block
+		uint8_t type;       // TRACETYPE
+		uint8_t lane;
+		int8_t payload[4];
+	};
+
+	// Ring of the most recent records. The audio thread is the only writer and never waits;
+	// readers copy a record and drop it if the writer lapped them during the copy.
+	// Defined inline: the host tools that link the plugin decode the ring with it too
+	class TraceBuffer {
+	private:
+		TraceRecord* records;
+		uint32_t capacity;
+		volatile uint32_t head;   // records written since construction
+	public:
+		TraceBuffer();
+		void init(TraceRecord* p_records, uint32_t p_capacity);
+		bool enabled() const { return capacity > 0; }
+		uint32_t written() const { return head; }
+		uint32_t oldest() const { return (head > capacity) ? head - capacity : 0; }   // first index read() may still return
+		void write(uint32_t block, int frame, TRACETYPE type, int lane, int a = 0, int b = 0, int c = 0, int d = 0);
+		bool read(uint32_t index, TraceRecord& record) const;
+		static int format(const TraceRecord& record, char* buffer);
+	};
+
+	inline TraceBuffer::TraceBuffer() {
+		records = nullptr;
+		capacity = 0;
+		head = 0;
+	}
+
+	inline void TraceBuffer::init(TraceRecord* p_records, uint32_t p_capacity) {
+		records = p_records;
+		capacity = p_records ? p_capacity : 0;
+		head = 0;
+	}
+
+	inline void TraceBuffer::write(uint32_t block, int frame, TRACETYPE type, int lane, int a, int b, int c, int d) {
+		if (capacity == 0)
+			return;
+		TraceRecord& record = records[head % capacity];
+		record.block = block;
+		record.frame = frame;
+		record.type = type;
+		record.lane = lane;
+		record.payload[0] = a;
+		record.payload[1] = b;
+		record.payload[2] = c;
+		record.payload[3] = d;
+		std::atomic_thread_fence(std::memory_order_release);
+		head = head + 1;
+	}
+
+	inline bool TraceBuffer::read(uint32_t index, TraceRecord& record) const {
+		// index counts from the first record ever written; false if not written yet or already overwritten
+		if ((capacity == 0) || (index >= head) || (head - index > capacity))
+			return false;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		record = records[index % capacity];
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return (head - index < capacity);   // the write of index + capacity had not started
+	}
+
+	static char* traceAppend(char* out, const char* text) {
+		while (*text)
+			*out++ = *text++;
+		return out;
+	}
+
+	static char* traceAppendInt(char* out, int value) {
+		char digits[12];
+		int n = 0;
+		unsigned int magnitude = (value < 0) ? -value : value;
+		if (value < 0)
+			*out++ = '-';
+		do {
+			digits[n++] = '0' + magnitude % 10;
+			magnitude /= 10;
+		} while (magnitude);
+		while (n)
+			*out++ = digits[--n];
+		return out;
+	}
+
+	inline int TraceBuffer::format(const TraceRecord& record, char* buffer) {
+		// one timeline line, e.g. "1234:17 L1 STEP 2>3 B"; steps print 1 based like the UI.
+		// No library calls so host decoders can use it as is. buffer needs 48 chars
+		static const char seqNames[] = "ABCDEFGH";
+		char* out = buffer;
+		out = traceAppendInt(out, record.block);
+		out = traceAppend(out, ":");
+		out = traceAppendInt(out, record.frame);
+		out = traceAppend(out, " L");
+		out = traceAppendInt(out, record.lane + 1);
+		const int8_t* p = record.payload;
+		switch (record.type) {
+			case TRACE_BEAT:
+				out = traceAppend(out, " BEAT ");
+				out = traceAppendInt(out, (uint8_t) p[0] | ((uint8_t) p[1] << 8));
+				break;
+			case TRACE_RESET:
+				out = traceAppend(out, " RESET");
+				break;
+			case TRACE_STEP:
+				out = traceAppend(out, " STEP ");
+				out = traceAppendInt(out, p[0] + 1);
+				out = traceAppend(out, ">");
+				out = traceAppendInt(out, p[1] + 1);
+				if (p[2] >= 0 && p[2] < 8) {
+					*out++ = ' ';
+					*out++ = seqNames[(int) p[2]];
+				}
+				break;
+			case TRACE_REPEAT:
+				out = traceAppend(out, " REP ");
+				out = traceAppendInt(out, p[0] + 1);
+				out = traceAppend(out, " ");
+				out = traceAppendInt(out, p[1]);
+				out = traceAppend(out, "/");
+				out = traceAppendInt(out, p[2]);
+				break;
+			case TRACE_PARAM:
+				out = traceAppend(out, " PARAM ");
+				out = traceAppendInt(out, (uint8_t) p[0] | ((uint8_t) p[1] << 8));
+				out = traceAppend(out, "=");
+				out = traceAppendInt(out, (int16_t) ((uint8_t) p[2] | ((uint8_t) p[3] << 8)));
+				break;
+			default:
+				out = traceAppend(out, " ?");
+				break;
+		}
+		*out = 0;
+		return out - buffer;
+	}
+} // namespace
@@ -0,0 +1,258 @@
+// Host stubs of the Disting NT API and the HostInstance around the plugin's factory; see HostNT.hpp.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <chrono>
+#include <mutex>
+#include "HostNT.hpp"
+
+static float workBuffer[HOST_BUSES * HOST_MAX_FRAMES];
+const _NT_globals NT_globals = { HOST_SAMPLE_RATE, HOST_MAX_FRAMES, workBuffer, sizeof(workBuffer) };
+uint8_t NT_screen[128 * 64];
+
+// the instance whose step(), parameterChanged() or draw() is running on this thread
+static thread_local HostInstance* hostCurrent = nullptr;
+
+uint64_t hostCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+uint32_t NT_getCpuCycleCount(void) { return (uint32_t) hostCycles(); }
+int32_t NT_algorithmIndex(const _NT_algorithm*) { return 0; }
+uint32_t NT_parameterOffset(void) { return 0; }
+
+void NT_setParameterFromAudio(uint32_t, uint32_t parameter, int16_t value) {
+    if (hostCurrent)
+        hostCurrent->queue(parameter - NT_parameterOffset(), value);
+}
+
+void NT_setParameterFromUi(uint32_t, uint32_t parameter, int16_t value) {
+    if (hostCurrent)
+        hostCurrent->queue(parameter - NT_parameterOffset(), value);
+}
+
+void NT_setParameterRange(_NT_parameter*, float, float, float, float) {}
+void NT_drawText(int, int, const char*, int, _NT_textAlignment, _NT_textSize) {}
+void NT_drawShapeI(_NT_shape, int, int, int, int, int) {}
+void NT_drawShapeF(_NT_shape, float, float, float, float, float) {}
+int NT_intToString(char* buffer, int32_t value) { return sprintf(buffer, "%d", (int) value); }
+int NT_floatToString(char* buffer, float value, int decimalPlaces) { return sprintf(buffer, "%.*f", decimalPlaces, value); }
+void NT_sendMidiByte(uint32_t, uint8_t) {}
+void NT_sendMidi2ByteMessage(uint32_t, uint8_t, uint8_t) {}
+void NT_sendMidi3ByteMessage(uint32_t, uint8_t, uint8_t, uint8_t) {}
+void NT_sendMidiSysEx(uint32_t, const uint8_t*, uint32_t, bool) {}
+
+const _NT_factory* hostFactory() {
+    // the static memory every instance shares is set up once, before the first instance is built
+    static std::once_flag once;
+    static std::vector<uint64_t> staticMemory;
+    static const _NT_factory* factory = nullptr;
+    std::call_once(once, []() {
+        factory = reinterpret_cast<const _NT_factory*>(pluginEntry(kNT_selector_factoryInfo, 0));
+        _NT_staticRequirements req = { 0 };
+        if (factory->calculateStaticRequirements)
+            factory->calculateStaticRequirements(req);
+        staticMemory.assign(req.dram / sizeof(uint64_t) + 1, 0);
+        _NT_staticMemoryPtrs ptrs = { reinterpret_cast<uint8_t*>(staticMemory.data()) };
+        if (factory->initialise)
+            factory->initialise(ptrs, req);
+    });
+    return factory;
+}
+
+void hostDefaultSpecifications(int32_t* specifications) {
+    const _NT_factory* factory = hostFactory();
+    for (uint32_t i = 0; i < factory->numSpecifications; i++)
+        specifications[i] = factory->specifications[i].def;
+}
+
+bool hostSpecification(const char* name, const char* value, int32_t* specifications) {
+    const _NT_factory* factory = hostFactory();
+    for (uint32_t i = 0; i < factory->numSpecifications; i++) {
+        const _NT_specification& spec = factory->specifications[i];
+        if (strcasecmp(spec.name, name) == 0) {
+            int v = atoi(value);
+            specifications[i] = (v < spec.min) ? spec.min : (v > spec.max) ? spec.max : v;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool hostIsBus(const _NT_parameter& parameter) {
+    return parameter.unit == kNT_unitAudioInput || parameter.unit == kNT_unitCvInput || hostIsOutput(parameter);
+}
+
+bool hostIsOutput(const _NT_parameter& parameter) {
+    return parameter.unit == kNT_unitAudioOutput || parameter.unit == kNT_unitCvOutput;
+}
+
+char* hostTrim(char* text) {
+    while (*text == ' ' || *text == '\t')
+        text++;
+    char* end = text + strlen(text);
+    while (end > text && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n'))
+        *--end = '\0';
+    return text;
+}
+
+bool hostReadPreset(const char* path, int32_t* specifications, HostSettings& settings, std::string& error) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        error = "cannot open";
+        return false;
+    }
+    char line[256];
+    for (int number = 1; fgets(line, sizeof(line), file); number++) {
+        char* comment = strchr(line, '#');
+        if (comment)
+            *comment = '\0';
+        char* equals = strchr(line, '=');
+        if (!equals) {
+            if (*hostTrim(line)) {
+                char text[64];
+                snprintf(text, sizeof(text), "line %d: no '='", number);
+                error = text;
+                fclose(file);
+                return false;
+            }
+            continue;
+        }
+        *equals = '\0';
+        std::string name = hostTrim(line);
+        std::string value = hostTrim(equals + 1);
+        if (!hostSpecification(name.c_str(), value.c_str(), specifications))
+            settings.push_back(std::make_pair(name, value));
+    }
+    fclose(file);
+    return true;
+}
+
+bool hostApply(HostInstance& instance, const HostSettings& settings, std::string& error) {
+    for (size_t i = 0; i < settings.size(); i++) {
+        if (!instance.set(settings[i].first.c_str(), settings[i].second.c_str())) {
+            error = "bad setting '" + settings[i].first + " = " + settings[i].second + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t HostInstance::sramSize(const int32_t* specifications) {
+    _NT_algorithmRequirements req = { 0 };
+    hostFactory()->calculateRequirements(req, specifications);
+    return req.sram;
+}
+
+HostInstance::HostInstance(const int32_t* p_specifications, uint8_t* sram) {
+    const _NT_factory* factory = hostFactory();
+    memcpy(specifications, p_specifications, factory->numSpecifications * sizeof(int32_t));
+    requirements = _NT_algorithmRequirements();
+    factory->calculateRequirements(requirements, specifications);
+    if (!sram) {
+        sramOwned.assign(requirements.sram / sizeof(uint64_t) + 1, 0);
+        sram = reinterpret_cast<uint8_t*>(sramOwned.data());
+    }
+    dram.assign(requirements.dram / sizeof(uint64_t) + 1, 0);
+    _NT_algorithmMemoryPtrs ptrs = { sram, reinterpret_cast<uint8_t*>(dram.data()), nullptr, nullptr };
+
+    // construct() reads the parameter values the NT has placed in the new algorithm, and the defaults are
+    // only known from the table construct() hands back: build once on zeros, then again on the defaults
+    memset(values, 0, sizeof(values));
+    _NT_algorithm* placed = reinterpret_cast<_NT_algorithm*>(sram);
+    placed->v = values;
+    placed->vIncludingCommon = values;
+    algorithm = factory->construct(ptrs, requirements, specifications);
+    for (uint32_t p = 0; p < requirements.numParameters; p++)
+        values[p] = algorithm->parameters[p].def;
+    memset(sram, 0, requirements.sram);
+    placed->v = values;
+    placed->vIncludingCommon = values;
+    algorithm = factory->construct(ptrs, requirements, specifications);
+    algorithm->v = values;
+    algorithm->vIncludingCommon = values;
+
+    // as a preset load: every parameter reported once
+    hostCurrent = this;
+    for (uint32_t p = 0; p < requirements.numParameters; p++)
+        factory->parameterChanged(algorithm, p);
+    applyQueued();
+    hostCurrent = nullptr;
+}
+
+int HostInstance::find(const char* name) const {
+    for (uint32_t p = 0; p < requirements.numParameters; p++) {
+        if (strcasecmp(algorithm->parameters[p].name, name) == 0)
+            return p;
+    }
+    return -1;
+}
+
+bool HostInstance::set(const char* name, const char* value) {
+    // a number, or for an enum parameter one of its names
+    int p = find(name);
+    if (p < 0)
+        return false;
+    const _NT_parameter& parameter = algorithm->parameters[p];
+    char* end = nullptr;
+    long number = strtol(value, &end, 10);
+    if (end == value || *end != '\0') {
+        if (parameter.unit != kNT_unitEnum || !parameter.enumStrings)
+            return false;
+        number = -1;
+        for (int v = parameter.min; v <= parameter.max; v++) {
+            if (strcasecmp(parameter.enumStrings[v - parameter.min], value) == 0)
+                number = v;
+        }
+        if (number < 0)
+            return false;
+    }
+    if (number < parameter.min || number > parameter.max)
+        return false;
+    set(p, (int) number);
+    return true;
+}
+
+void HostInstance::set(int parameter, int value) {
+    values[parameter] = value;
+    hostCurrent = this;
+    hostFactory()->parameterChanged(algorithm, parameter);
+    applyQueued();
+    hostCurrent = nullptr;
+}
+
+void HostInstance::step(float* busFrames, int numFrames) {
+    hostCurrent = this;
+    hostFactory()->step(algorithm, busFrames, numFrames / 4);
+    applyQueued();
+    hostCurrent = nullptr;
+}
+
+bool HostInstance::draw() {
+    hostCurrent = this;
+    bool drawn = hostFactory()->draw ? hostFactory()->draw(algorithm) : false;
+    applyQueued();
+    hostCurrent = nullptr;
+    return drawn;
+}
+
+void HostInstance::queue(uint32_t parameter, int16_t value) {
+    if (parameter < requirements.numParameters)
+        queued.push_back((parameter << 16) | (uint16_t) value);
+}
+
+void HostInstance::applyQueued() {
+    // the NT applies parameters set from the audio thread after the call that set them
+    for (size_t i = 0; i < queued.size(); i++) {
+        int parameter = queued[i] >> 16;
+        values[parameter] = (int16_t) (queued[i] & 0xFFFF);
+        hostFactory()->parameterChanged(algorithm, parameter);
+    }
+    queued.clear();
+}
@@ -0,0 +1,71 @@
+// Host side of the Disting NT API, for the tools that run the whole plugin rather than the sequencing core.
+// HostNT.cpp stubs the NT_ calls SongSequencer.cpp makes, and HostInstance builds an algorithm through the
+// plugin's factory the way the NT does: static memory once, then requirements, memory and construct.
+// The plugin is linked in as its own translation unit, so only what the factory exposes is reachable.
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include "api.h"
+#include "StateSnapshot.hpp"
+#include "TraceBuffer.hpp"
+
+static const int HOST_BUSES = 28;
+static const uint32_t HOST_SAMPLE_RATE = 48000;
+static const uint32_t HOST_MAX_FRAMES = 128;    // NT_globals.maxFramesPerStep
+
+const _NT_factory* hostFactory();
+
+// A time stamp for measuring on the host: the TSC on x86, nanoseconds elsewhere
+uint64_t hostCycles();
+
+class HostInstance {
+public:
+    static const int MAX_PARAMETERS = 256;
+private:
+    std::vector<uint64_t> sramOwned;
+    std::vector<uint64_t> dram;
+    int16_t values[MAX_PARAMETERS];
+    int32_t specifications[8];
+    _NT_algorithmRequirements requirements;
+    std::vector<uint32_t> queued;   // NT_setParameterFromAudio() calls made during the last call in, as parameter << 16 | value
+    void applyQueued();
+public:
+    _NT_algorithm* algorithm;
+
+    // specifications as the factory lists them; sram, if given, must hold sramSize() bytes
+    static uint32_t sramSize(const int32_t* specifications);
+    HostInstance(const int32_t* p_specifications, uint8_t* sram = nullptr);
+    int numParameters() const { return requirements.numParameters; }
+    int find(const char* name) const;
+    bool set(const char* name, const char* value);
+    void set(int parameter, int value);
+    int get(int parameter) const { return values[parameter]; }
+    void step(float* busFrames, int numFrames);
+    bool draw();
+    void queue(uint32_t parameter, int16_t value);
+};
+
+// Specification values from "Name = value" lines (Lanes, Trace, Songs, Voices); false if the name is not one
+bool hostSpecification(const char* name, const char* value, int32_t* specifications);
+void hostDefaultSpecifications(int32_t* specifications);
+
+typedef std::vector<std::pair<std::string, std::string> > HostSettings;
+
+// A preset file: "Name = value" lines, # starting a comment. Specifications are set in specifications (start
+// from hostDefaultSpecifications()), the rest go to settings for hostApply(). False, with error, when the file
+// cannot be read or a line has no '='
+bool hostReadPreset(const char* path, int32_t* specifications, HostSettings& settings, std::string& error);
+bool hostApply(HostInstance& instance, const HostSettings& settings, std::string& error);
+
+// parameters that pick a bus, and of those the ones the algorithm writes
+bool hostIsBus(const _NT_parameter& parameter);
+bool hostIsOutput(const _NT_parameter& parameter);
+
+// text with leading and trailing blanks and line ends cut off, in place
+char* hostTrim(char* text);
+
+// Defined by SongSequencer.cpp when built with SONGSEQ_HOST, as the tools build it
+const CLC_Synths::TraceBuffer& songSequencerTrace(const _NT_algorithm* self);
+bool songSequencerLaneState(const _NT_algorithm* self, int lane, CLC_Synths::SongState& state);
@@ -0,0 +1,223 @@
+// Host benchmark for many instances of the plugin in one preset, as the NT runs them: one after another on
+// one core, sharing one set of buses, each instance's SRAM laid out between the working sets of the other
+// algorithms. For 1, 2, 4 .. up to the instance count it steps every instance in turn for each block and
+// prints, per instance, the cycles step() took (mean and worst block, and per frame) and, where the kernel
+// allows perf events, the cache misses and L1 data cache read misses during its step().
+//
+//   make bench    ./bench [-n instances] [-w working set KiB] [-b block frames] [-t blocks] [-p preset]
+//
+// Each instance's SRAM is followed by a dummy working set of -w KiB (default 32) that is written through
+// before the instance steps, so the instance starts each block with its own memory pushed out of the cache
+// as it would be behind other algorithms. The Beat input (bus 2) gets a beat every 2400 frames and Reset
+// (bus 1) a pulse at the start; the first 64 blocks are not measured. A preset, as read by render, applies
+// to every instance.
+//
+// The cycle figures are hostCycles(): the TSC on x86, so they compare instance counts and working sets on
+// one machine, not with the NT's Cortex-M7.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "HostNT.hpp"
+
+static const int MAX_INSTANCES = 32;
+static const int WARMUP_BLOCKS = 64;
+static const uint32_t CACHE_LINE = 64;
+static const uint32_t BEAT_PERIOD = 2400;
+static const uint32_t BEAT_PHASE = 1200;
+static const uint32_t RESET_FRAMES = 64;
+
+// A perf event counting this thread in user space, or fd -1 where perf events are not allowed
+struct Counter {
+    int fd;
+
+    Counter(uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~Counter() {
+        if (fd >= 0)
+            close(fd);
+    }
+    uint64_t read() const {
+        uint64_t value = 0;
+        if (fd >= 0 && ::read(fd, &value, sizeof(value)) != sizeof(value))
+            value = 0;
+        return value;
+    }
+};
+
+struct Measure {
+    uint64_t cycles;
+    uint64_t worst;
+    uint64_t misses;
+    uint64_t l1Misses;
+};
+
+static uint32_t roundUp(uint32_t bytes) {
+    return (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+}
+
+static void fillInputs(float* busFrames, uint32_t first, int numFrames) {
+    // only the Reset and Beat buses; whatever the instances wrote elsewhere stays, as on the NT
+    for (int frame = 0; frame < numFrames; frame++) {
+        uint32_t at = first + frame;
+        busFrames[frame] = (at < RESET_FRAMES) ? 10.f : 0.f;
+        busFrames[numFrames + frame] = (at >= BEAT_PHASE && (at - BEAT_PHASE) % BEAT_PERIOD < BEAT_PERIOD / 2) ? 10.f : 0.f;
+    }
+}
+
+static void touch(uint8_t* workingSet, uint32_t bytes) {
+    // a write to every cache line, as another algorithm running over its own memory
+    for (uint32_t offset = 0; offset < bytes; offset += CACHE_LINE)
+        workingSet[offset] += 1;
+}
+
+static bool run(int count, const int32_t* specifications, const HostSettings& settings, uint32_t workingSet,
+                int block, int blocks, const Counter& misses, const Counter& l1Misses) {
+    // one arena: SRAM 1, working set 1, SRAM 2, working set 2 ...
+    uint32_t sram = roundUp(HostInstance::sramSize(specifications));
+    uint32_t stride = sram + workingSet;
+    void* memory = nullptr;
+    if (posix_memalign(&memory, CACHE_LINE, (size_t) stride * count) != 0) {
+        fprintf(stderr, "out of memory for %d instances\n", count);
+        return false;
+    }
+    uint8_t* arena = static_cast<uint8_t*>(memory);
+    memset(arena, 0, (size_t) stride * count);
+
+    std::vector<std::unique_ptr<HostInstance> > instances;
+    for (int i = 0; i < count; i++) {
+        instances.push_back(std::unique_ptr<HostInstance>(new HostInstance(specifications, arena + (size_t) stride * i)));
+        std::string error;
+        if (!hostApply(*instances.back(), settings, error)) {
+            fprintf(stderr, "preset: %s\n", error.c_str());
+            free(memory);
+            return false;
+        }
+    }
+
+    std::vector<float> busFrames(HOST_BUSES * block, 0.f);
+    std::vector<Measure> measures(count, Measure());
+    uint64_t worstRound = 0;        // the most cycles all the instances took over one block
+    for (int b = 0; b < WARMUP_BLOCKS + blocks; b++) {
+        fillInputs(busFrames.data(), (uint32_t) b * block, block);
+        uint64_t round = 0;
+        for (int i = 0; i < count; i++) {
+            touch(arena + (size_t) stride * i + sram, workingSet);
+            uint64_t missesBefore = misses.read();
+            uint64_t l1Before = l1Misses.read();
+            uint64_t start = hostCycles();
+            instances[i]->step(busFrames.data(), block);
+            uint64_t cycles = hostCycles() - start;
+            uint64_t l1After = l1Misses.read();
+            uint64_t missesAfter = misses.read();
+            if (b < WARMUP_BLOCKS)
+                continue;
+            round += cycles;
+            Measure& m = measures[i];
+            m.cycles += cycles;
+            if (cycles > m.worst)
+                m.worst = cycles;
+            m.misses += missesAfter - missesBefore;
+            m.l1Misses += l1After - l1Before;
+        }
+        if (round > worstRound)
+            worstRound = round;
+    }
+
+    printf("%d instance%s, %u bytes SRAM each, %u KiB working set between, %d blocks of %d frames\n", count,
+           (count == 1) ? "" : "s", HostInstance::sramSize(specifications), workingSet / 1024, blocks, block);
+    printf("  instance  cycles/block  worst block  cycles/frame  misses/block  L1D misses/block\n");
+    Measure total = Measure();
+    total.worst = worstRound;
+    for (int i = 0; i <= count; i++) {
+        const Measure& m = (i < count) ? measures[i] : total;
+        char name[16];
+        if (i < count)
+            snprintf(name, sizeof(name), "%d", i + 1);
+        else
+            snprintf(name, sizeof(name), "all");
+        char cacheText[48];
+        if (misses.fd >= 0 || l1Misses.fd >= 0)
+            snprintf(cacheText, sizeof(cacheText), "%12.1f  %16.1f", (double) m.misses / blocks, (double) m.l1Misses / blocks);
+        else
+            snprintf(cacheText, sizeof(cacheText), "%12s  %16s", "-", "-");
+        printf("  %8s  %12.0f  %11llu  %12.1f  %s\n", name, (double) m.cycles / blocks, (unsigned long long) m.worst,
+               (double) m.cycles / blocks / block, cacheText);
+        if (i < count) {
+            total.cycles += m.cycles;
+            total.misses += m.misses;
+            total.l1Misses += m.l1Misses;
+        }
+    }
+    instances.clear();
+    free(memory);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int instances = MAX_INSTANCES;
+    uint32_t workingSet = 32 * 1024;
+    int block = 32;
+    int blocks = 3000;
+    const char* preset = nullptr;
+    const char* usage = "usage: %s [-n instances] [-w working set KiB] [-b block frames] [-t blocks] [-p preset]\n";
+    int opt;
+    while ((opt = getopt(argc, argv, "n:w:b:t:p:")) != -1) {
+        switch (opt) {
+            case 'n': instances = atoi(optarg); break;
+            case 'w': workingSet = (uint32_t) atoi(optarg) * 1024; break;
+            case 'b': block = atoi(optarg); break;
+            case 't': blocks = atoi(optarg); break;
+            case 'p': preset = optarg; break;
+            default:
+                fprintf(stderr, usage, argv[0]);
+                return 2;
+        }
+    }
+    if (optind != argc || instances < 1 || instances > MAX_INSTANCES || block < 4 || block > (int) HOST_MAX_FRAMES ||
+        block % 4 != 0 || blocks < 1) {
+        fprintf(stderr, usage, argv[0]);
+        return 2;
+    }
+
+    int32_t specifications[8];
+    hostDefaultSpecifications(specifications);
+    HostSettings settings;
+    std::string error;
+    if (preset && !hostReadPreset(preset, specifications, settings, error)) {
+        fprintf(stderr, "%s: %s\n", preset, error.c_str());
+        return 2;
+    }
+
+    Counter misses(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    Counter l1Misses(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    if (misses.fd < 0 && l1Misses.fd < 0)
+        fprintf(stderr, "perf events not available, cache misses not counted\n");
+
+    // 1, 2, 4 .. and the count asked for
+    for (int count = 1;; count *= 2) {
+        if (count > instances)
+            count = instances;
+        if (!run(count, specifications, settings, roundUp(workingSet), block, blocks, misses, l1Misses))
+            return 1;
+        if (count == instances)
+            break;
+    }
+    return 0;
+}
@@ -0,0 +1,574 @@
+// Host exhaustive explorer for arrangements: every song in a configured space is played through from a
+// reset and checked against a reference model written independently of HighSeqModule and StepOrder.
+//
+// Step songs (the default) cover every switch mask, every step order (Random with -s seeds) and every
+// assignment of the -v step variants below to the eight steps. Arrangement songs (-a N) cover every
+// program of N instructions over a small alphabet, with steps 1..3 switched on in every combination.
+// Each song is checked for:
+//   - verifyArrangement() below, a one pass check through the module's public interface, giving the
+//     expected result
+//   - HighSeqModule::checkInvariants() after every frame, and the module going idle after every beat
+//   - every visit holding its step for (repeats + 1) x bars x beats per bar beats
+//   - step songs: the visits of -p passes in the order the reference gives (Forward, Reverse, Ping-Pong),
+//     or for Random every pass a permutation of the steps on, never the same step twice running, and
+//     songLength() equal to the reference pass length
+//   - Arrangement songs: the instructions compile() drops, which is every one of them for a program with
+//     Loops open deeper than ProgramCursor::MAX_LOOP_DEPTH, and otherwise each Loop and Next left unpaired
+//
+// The space is numbered in mixed radix and cut into chunks dealt out to per thread queues; a thread that
+// runs dry steals from the front of another's queue. Results merge to the lowest failing song per kind,
+// so the report is the same for any thread count.
+//
+//   make explore    ./explore [-j threads] [-v variants] [-s seeds] [-p passes] [-a instructions]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "HighSeqModule.hpp"
+
+using namespace CLC_Synths;
+
+static const int SETTLE_FRAMES = 8;     // frames after a beat that stepSongSequencer() may run per frame
+static const int MAX_VISITS = 3 * HighSeqModule::MAX_PASS_VISITS;   // visits one song is followed for at most
+static const uint64_t CHUNK = 256;      // songs per unit of work
+
+// a step's sequencer and repeats; sequencer lengths come from sequencerShapes
+struct StepVariant {
+    int sequencer;
+    int repeats;
+};
+
+static const StepVariant stepVariants[] = {
+    { 0, 0 },               // 1 beat
+    { 1, 1 },               // 2 x 3 beats
+    { 2, 0 },               // 2 bars of 2
+    { 0, MasterStep::MAX_REPEATS },
+};
+static const int MAX_VARIANTS = sizeof(stepVariants) / sizeof(stepVariants[0]);
+
+static const int sequencerShapes[][2] = {   // beats per bar, bars
+    { 1, 1 }, { 3, 1 }, { 2, 2 }, { 1, 1 }, { 1, 1 }, { 1, 1 }, { 1, 1 }, { 1, 1 },
+};
+static_assert(sizeof(sequencerShapes) / sizeof(sequencerShapes[0]) == HighSeqModule::NUM_SEQUENCERS, "one shape per sequencer");
+
+// Arrangement values programs are built from
+static const int16_t programAlphabet[] = {
+    SOURCE_STEP1, SOURCE_STEP1 + 1, SOURCE_STEP1 + 2, SOURCE_LOOP, SOURCE_NEXT2, SOURCE_NEXT2 + 1,
+    SOURCE_GOTO1, SOURCE_GOTO1 + 2, SOURCE_END,
+};
+static const int PROGRAM_SYMBOLS = sizeof(programAlphabet) / sizeof(programAlphabet[0]);
+static const int PROGRAM_STEPS = 3;     // steps the alphabet plays
+
+enum ANOMALY {
+    ANOMALY_VERIFY,         // verifyArrangement() disagrees
+    ANOMALY_INVARIANT,      // checkInvariants() failed
+    ANOMALY_STUCK,          // not idle SETTLE_FRAMES after a beat
+    ANOMALY_LENGTH,         // a visit left its step early
+    ANOMALY_ORDER,          // visits out of the reference order
+    ANOMALY_SONG_LENGTH,    // songLength() is not the reference pass length
+    ANOMALY_NESTING,        // compile() dropped other instructions than the reference: a nesting or pairing fault
+    NUM_ANOMALIES
+};
+
+static const char* const anomalyNames[NUM_ANOMALIES] = {
+    "verify", "invariant", "stuck", "visit length", "order", "song length", "nesting",
+};
+
+struct Options {
+    int threads;
+    int variants;
+    int seeds;
+    int passes;
+    int instructions;       // program length, 0 = step songs
+};
+
+struct Song {
+    unsigned mask;
+    int order;
+    uint32_t seed;
+    int variant[HighSeqModule::NUM_STEPS];
+    int16_t source[SongProgram::MAX_INSTRUCTIONS];
+};
+
+struct Findings {
+    uint64_t count[NUM_ANOMALIES];
+    uint64_t first[NUM_ANOMALIES];      // lowest song index of each kind
+    int detail[NUM_ANOMALIES];
+    Findings() {
+        for (int kind = 0; kind < NUM_ANOMALIES; kind++) {
+            count[kind] = 0;
+            first[kind] = UINT64_MAX;
+            detail[kind] = 0;
+        }
+    }
+    void add(int kind, uint64_t index, int value) {
+        if (count[kind]++ == 0 || index < first[kind]) {
+            first[kind] = index;
+            detail[kind] = value;
+        }
+    }
+    void merge(const Findings& other) {
+        for (int kind = 0; kind < NUM_ANOMALIES; kind++) {
+            count[kind] += other.count[kind];
+            if (other.first[kind] < first[kind]) {
+                first[kind] = other.first[kind];
+                detail[kind] = other.detail[kind];
+            }
+        }
+    }
+};
+
+static uint64_t spaceSize(const Options& options) {
+    uint64_t size = 1;
+    if (options.instructions > 0) {
+        for (int i = 0; i < options.instructions; i++)
+            size *= PROGRAM_SYMBOLS;
+        return size << PROGRAM_STEPS;
+    }
+    for (int step = 0; step < HighSeqModule::NUM_STEPS; step++)
+        size *= options.variants;
+    return size * (ORDER_RANDOM + options.seeds) << HighSeqModule::NUM_STEPS;
+}
+
+static void decode(const Options& options, uint64_t index, Song& song) {
+    // mixed radix, switch mask fastest
+    memset(&song, 0, sizeof(song));
+    if (options.instructions > 0) {
+        song.mask = index % (1u << PROGRAM_STEPS);
+        index >>= PROGRAM_STEPS;
+        for (int i = 0; i < options.instructions; i++) {
+            song.source[i] = programAlphabet[index % PROGRAM_SYMBOLS];
+            index /= PROGRAM_SYMBOLS;
+        }
+        for (int step = 0; step < HighSeqModule::NUM_STEPS; step++)
+            song.variant[step] = step % options.variants;
+        return;
+    }
+    song.mask = index % (1u << HighSeqModule::NUM_STEPS);
+    index >>= HighSeqModule::NUM_STEPS;
+    int order = index % (ORDER_RANDOM + options.seeds);
+    index /= ORDER_RANDOM + options.seeds;
+    song.order = (order < ORDER_RANDOM) ? order : ORDER_RANDOM;
+    song.seed = (order < ORDER_RANDOM) ? 0 : order - ORDER_RANDOM;
+    for (int step = 0; step < HighSeqModule::NUM_STEPS; step++) {
+        song.variant[step] = index % options.variants;
+        index /= options.variants;
+    }
+}
+
+static int visitLength(int variant) {
+    const int* shape = sequencerShapes[stepVariants[variant].sequencer];
+    return (stepVariants[variant].repeats + 1) * shape[0] * shape[1];
+}
+
+static int referenceOrder(const Song& song, int8_t* pass) {
+    // one pass of a step song as the README describes it; Random has no fixed order and gives its steps
+    // ascending, the checks on its passes only need the set
+    int8_t on[HighSeqModule::NUM_STEPS];
+    int count = 0;
+    for (int step = 0; step < HighSeqModule::NUM_STEPS; step++) {
+        if (song.mask & (1u << step))
+            on[count++] = step;
+    }
+    int length = 0;
+    if (song.order == ORDER_REVERSE) {
+        for (int i = count - 1; i >= 0; i--)
+            pass[length++] = on[i];
+        return length;
+    }
+    for (int i = 0; i < count; i++)
+        pass[length++] = on[i];
+    if (song.order == ORDER_PINGPONG) {
+        for (int i = count - 2; i > 0; i--)
+            pass[length++] = on[i];
+    }
+    return length;
+}
+
+enum ARRANGEMENT {   // bits returned by verifyArrangement()
+    ARRANGEMENT_NO_STEPS = 1,   // every step is switched off, the song never starts
+    ARRANGEMENT_ORDER = 2,      // a step played out of order or was skipped
+    ARRANGEMENT_LENGTH = 4,     // a step played a different number of beats than its repeats and bars ask for
+    ARRANGEMENT_CYCLE = 8,      // the song did not return to its first step after songLength() beats
+};
+
+static void simulateBeat(HighSeqModule& module) {
+    // one beat frame, then the frames after it until nothing is pending, as step() runs them
+    for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++)
+        module.sequencers[s].set_beatState(BEATSTATE::FIRSTHIGH);
+    module.process();
+    for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++)
+        module.sequencers[s].set_beatState(BEATSTATE::LOW);
+    for (int frame = 0; (frame < SETTLE_FRAMES) && !module.isIdle(); frame++)
+        module.process();
+}
+
+static int verifyArrangement(const HighSeqModule& module, bool programmed) {
+    // plays one pass of the song from a reset on a scratch copy, through the module's public interface only,
+    // and checks every step comes up in turn for (repeats + 1) * bars * beats per bar beats. programmed is
+    // set when the module plays an Arrangement. Returns ARRANGEMENT bits, 0 if the song plays as set
+    if (!module.guard())
+        return 0;
+    HighSeqModule sim = module;
+    for (int s = 0; s < HighSeqModule::NUM_STEPS; s++)
+        sim.steps[s].reset();
+    for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++) {
+        sim.sequencers[s].reset();
+        sim.sequencers[s].set_beatState(BEATSTATE::LOW);
+    }
+    sim.reset();
+    if (sim.getMasterStep() == -1)
+        return ARRANGEMENT_NO_STEPS;
+    for (int frame = 0; (frame < SETTLE_FRAMES) && !sim.isIdle(); frame++)
+        sim.process();
+
+    int failed = 0;
+    int length = module.songLength();
+    int beatsOnStep = 0;
+    int8_t visits[HighSeqModule::MAX_PASS_VISITS];
+    bool comesRound = !programmed || (module.passSteps(visits, HighSeqModule::MAX_PASS_VISITS) < HighSeqModule::MAX_PASS_VISITS);
+    for (int beat = 0; beat < length; beat++) {
+        int step = sim.getMasterStep();
+        if (step == -1)
+            break;
+        int next = sim.upcomingStep();   // -1 unless this beat ends the visit
+        const MasterStep& running = sim.steps[step];
+        int visit = (running.getRepeats() + 1) * sim.sequencers[running.getAssignedSeq()].gettargetBeats();
+        simulateBeat(sim);
+        beatsOnStep++;
+        if (sim.getMasterStep() != step) {
+            if (sim.getMasterStep() != next)
+                failed |= ARRANGEMENT_ORDER;
+            if (beatsOnStep != visit)
+                failed |= ARRANGEMENT_LENGTH;
+            beatsOnStep = 0;
+        } else if (beatsOnStep == visit) {
+            if (next != step)
+                failed |= ARRANGEMENT_LENGTH;   // overran its visit
+            beatsOnStep = 0;                    // the only step on starts over
+        }
+        if (failed)
+            return failed;
+    }
+    // a program that ends stops instead of coming round, and one that goes to a loop after an intro never
+    // comes back to its first instruction; Random comes round to a new order
+    if (comesRound && ((!sim.passStarted() && !(programmed && (sim.getMasterStep() == -1))) || (beatsOnStep != 0)))
+        failed |= ARRANGEMENT_CYCLE;
+    return failed;
+}
+
+class Explorer {
+    const Options& options;
+    Findings& findings;
+    uint64_t index;
+    HighSeqModule module;
+    SongProgram program;
+    bool failed;
+
+    void report(int kind, int detail) {
+        findings.add(kind, index, detail);
+        failed = true;
+    }
+    bool settle();
+    bool beat();
+    int play(int8_t* visits, int limit);
+    void checkSteps(const Song& song, const int8_t* visits, int count);
+public:
+    Explorer(const Options& p_options, Findings& p_findings) : options(p_options), findings(p_findings), index(0), failed(false) {}
+    void explore(uint64_t p_index);
+};
+
+bool Explorer::settle() {
+    // frames after a beat until nothing is pending, as the per frame loop keeps running them
+    for (int frame = 0; !module.isIdle(); frame++) {
+        if (frame == SETTLE_FRAMES) {
+            report(ANOMALY_STUCK, frame);
+            return false;
+        }
+        module.process();
+        int bits = module.checkInvariants();
+        if (bits) {
+            report(ANOMALY_INVARIANT, bits);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Explorer::beat() {
+    // a beat on the shared Beat input, then the frames after it
+    for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++)
+        module.sequencers[s].set_beatState(BEATSTATE::FIRSTHIGH);
+    module.process();
+    for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++)
+        module.sequencers[s].set_beatState(BEATSTATE::LOW);
+    int bits = module.checkInvariants();
+    if (bits) {
+        report(ANOMALY_INVARIANT, bits);
+        return false;
+    }
+    return settle();
+}
+
+int Explorer::play(int8_t* visits, int limit) {
+    // up to limit visits of the song from its first step; each must hold its step for the whole visit
+    int count = 0;
+    while (count < limit) {
+        int step = module.getMasterStep();
+        if (step == -1)
+            break;   // a program that ended
+        visits[count++] = step;
+        const MasterStep& running = module.steps[step];
+        int length = (running.getRepeats() + 1) * module.sequencers[running.getAssignedSeq()].gettargetBeats();
+        for (int beat = 0; beat < length; beat++) {
+            if (module.getMasterStep() != step) {
+                report(ANOMALY_LENGTH, beat - length);
+                return count;
+            }
+            if (!this->beat())
+                return count;
+        }
+    }
+    return count;
+}
+
+void Explorer::checkSteps(const Song& song, const int8_t* visits, int count) {
+    int8_t pass[StepOrder::MAX_LENGTH];
+    int passLength = referenceOrder(song, pass);
+    if (count != options.passes * passLength) {
+        report(ANOMALY_ORDER, count);
+        return;
+    }
+    if (song.order != ORDER_RANDOM || passLength < 3) {
+        for (int i = 0; i < count; i++) {
+            if (visits[i] != pass[i % passLength]) {
+                report(ANOMALY_ORDER, i);
+                return;
+            }
+        }
+        return;
+    }
+    for (int start = 0; start < count; start += passLength) {
+        unsigned seen = 0;
+        for (int i = start; i < start + passLength; i++) {
+            seen |= 1u << visits[i];
+            if (i > 0 && visits[i] == visits[i - 1]) {
+                report(ANOMALY_ORDER, i);
+                return;
+            }
+        }
+        if (seen != song.mask) {
+            report(ANOMALY_ORDER, start);
+            return;
+        }
+    }
+}
+
+void Explorer::explore(uint64_t p_index) {
+    Song song;
+    index = p_index;
+    failed = false;
+    decode(options, index, song);
+
+    // as constructSongSequencer() and the parameters would set it up
+    module = HighSeqModule();
+    for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++) {
+        module.sequencers[s].set_beatsPerBar(sequencerShapes[s][0]);
+        module.sequencers[s].set_bars(sequencerShapes[s][1]);
+    }
+    int stepsPlayed = (options.instructions > 0) ? PROGRAM_STEPS : HighSeqModule::NUM_STEPS;
+    for (int step = 0; step < HighSeqModule::NUM_STEPS; step++) {
+        module.steps[step].set_sequencer(stepVariants[song.variant[step]].sequencer);
+        module.steps[step].set_repeats(stepVariants[song.variant[step]].repeats);
+        bool on = (step < stepsPlayed) && (song.mask & (1u << step));
+        module.steps[step].set_switch(on ? SWITCHSTATE::ON : SWITCHSTATE::OFF);
+    }
+    module.assertInitialized();
+    module.setOrder(song.order, song.seed);
+    if (options.instructions > 0) {
+        // reference: each Next closes the innermost open Loop; a Next with none open and a Loop never
+        // closed are dropped, and Loops open deeper than the limit drop the whole program
+        int depth = 0;
+        int deepest = 0;
+        int used = 0;
+        int unpaired = 0;
+        for (int i = 0; i < options.instructions; i++) {
+            int value = song.source[i];
+            if (value == SOURCE_LOOP)
+                deepest = (++depth > deepest) ? depth : deepest;
+            else if (value >= SOURCE_NEXT2 && value < SOURCE_GOTO1)
+                (depth > 0) ? depth-- : unpaired++;
+            used += (value != SOURCE_EMPTY);
+        }
+        int expected = (deepest > ProgramCursor::MAX_LOOP_DEPTH) ? used : unpaired + depth;
+        int dropped = program.compile(song.source, options.instructions);
+        if (dropped != expected || (expected == used && program.size() != 0)) {
+            report(ANOMALY_NESTING, dropped);
+            return;
+        }
+        module.setProgram(program.size() > 0 ? &program : nullptr);
+    }
+    module.reset();
+    if (!settle())
+        return;
+
+    int expected = (song.mask == 0) ? ARRANGEMENT_NO_STEPS : 0;
+    int verified = verifyArrangement(module, (options.instructions > 0) && (program.size() > 0));
+    if (options.instructions > 0) {
+        // a program may find nothing to play whatever the switches
+        verified &= ~ARRANGEMENT_NO_STEPS;
+        expected = 0;
+    }
+    if (verified != expected) {
+        report(ANOMALY_VERIFY, verified);
+        return;
+    }
+    if (song.mask == 0)
+        return;
+
+    int8_t visits[MAX_VISITS];
+    if (options.instructions > 0) {
+        int limit = options.passes * HighSeqModule::MAX_PASS_VISITS;
+        play(visits, (limit < MAX_VISITS) ? limit : MAX_VISITS);
+        return;
+    }
+    int8_t pass[StepOrder::MAX_LENGTH];
+    int passLength = referenceOrder(song, pass);
+    int passBeats = 0;
+    for (int i = 0; i < passLength; i++)
+        passBeats += visitLength(song.variant[pass[i]]);
+    if (module.songLength() != passBeats) {
+        report(ANOMALY_SONG_LENGTH, module.songLength() - passBeats);
+        return;
+    }
+    int count = play(visits, options.passes * passLength);
+    if (!failed)
+        checkSteps(song, visits, count);
+}
+
+// Per thread queues of chunks; the owner takes from the back, thieves from the front
+struct WorkQueue {
+    std::mutex lock;
+    std::deque<uint64_t> chunks;
+};
+
+static bool takeChunk(std::vector<WorkQueue>& queues, int self, uint64_t& chunk) {
+    {
+        std::lock_guard<std::mutex> guard(queues[self].lock);
+        if (!queues[self].chunks.empty()) {
+            chunk = queues[self].chunks.back();
+            queues[self].chunks.pop_back();
+            return true;
+        }
+    }
+    for (size_t k = 1; k < queues.size(); k++) {
+        WorkQueue& victim = queues[(self + k) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.chunks.empty()) {
+            chunk = victim.chunks.front();
+            victim.chunks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+static void describe(const Options& options, uint64_t index) {
+    static const char* const orderNames[] = { "Forward", "Reverse", "Ping-Pong", "Random" };
+    Song song;
+    decode(options, index, song);
+    printf("    song %llu: steps on", (unsigned long long) index);
+    for (int step = 0; step < HighSeqModule::NUM_STEPS; step++) {
+        if (song.mask & (1u << step))
+            printf(" %d", step + 1);
+    }
+    if (options.instructions > 0) {
+        printf(", Arrangement");
+        for (int i = 0; i < options.instructions; i++)
+            printf(" %d", song.source[i]);
+    } else {
+        printf(", %s", orderNames[song.order]);
+        if (song.order == ORDER_RANDOM)
+            printf(" seed %u", song.seed);
+    }
+    printf(", variants");
+    for (int step = 0; step < HighSeqModule::NUM_STEPS; step++)
+        printf(" %d", song.variant[step]);
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    options.threads = (int) std::thread::hardware_concurrency();
+    options.threads = (options.threads > 0) ? options.threads : 1;
+    options.variants = 2;
+    options.seeds = 2;
+    options.passes = 3;
+    options.instructions = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "j:v:s:p:a:")) != -1) {
+        switch (opt) {
+            case 'j': options.threads = atoi(optarg); break;
+            case 'v': options.variants = atoi(optarg); break;
+            case 's': options.seeds = atoi(optarg); break;
+            case 'p': options.passes = atoi(optarg); break;
+            case 'a': options.instructions = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-j threads] [-v variants 1..%d] [-s seeds] [-p passes] [-a instructions 1..%d]\n",
+                        argv[0], MAX_VARIANTS, SongProgram::MAX_INSTRUCTIONS);
+                return 2;
+        }
+    }
+    if (options.threads < 1 || options.variants < 1 || options.variants > MAX_VARIANTS || options.seeds < 1 ||
+        options.passes < 1 || options.instructions < 0 || options.instructions > SongProgram::MAX_INSTRUCTIONS) {
+        fprintf(stderr, "%s: option out of range\n", argv[0]);
+        return 2;
+    }
+
+    uint64_t songs = spaceSize(options);
+    uint64_t chunks = (songs + CHUNK - 1) / CHUNK;
+    std::vector<WorkQueue> queues(options.threads);
+    for (uint64_t chunk = 0; chunk < chunks; chunk++)
+        queues[chunk % options.threads].chunks.push_back(chunk);
+
+    std::vector<Findings> found(options.threads);
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < options.threads; t++) {
+        workers.push_back(std::thread([&, t]() {
+            Explorer explorer(options, found[t]);
+            uint64_t chunk;
+            while (takeChunk(queues, t, chunk)) {
+                uint64_t end = (chunk + 1) * CHUNK;
+                for (uint64_t index = chunk * CHUNK; index < end && index < songs; index++)
+                    explorer.explore(index);
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    Findings total;
+    for (int t = 0; t < options.threads; t++)
+        total.merge(found[t]);
+    uint64_t anomalies = 0;
+    printf("%llu %s songs on %d threads in %.1f s\n", (unsigned long long) songs,
+           options.instructions ? "Arrangement" : "step", options.threads, seconds);
+    for (int kind = 0; kind < NUM_ANOMALIES; kind++) {
+        printf("  %-12s %llu\n", anomalyNames[kind], (unsigned long long) total.count[kind]);
+        if (total.count[kind]) {
+            describe(options, total.first[kind]);
+            printf("    detail %d\n", total.detail[kind]);
+        }
+        anomalies += total.count[kind];
+    }
+    return anomalies ? 1 : 0;
+}
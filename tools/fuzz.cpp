@@ -0,0 +1,475 @@
+// Host fuzz and property harness for the sequencing core: HighSeqModule, MasterStep and Sequencer.
+//
+// An input is a string of operations: beats on some or all sequencers, idle frames, resets, jumps, step
+// and sequencer edits, the modulation CVs, step orders and Arrangement programs. Frames are run the way
+// stepSongSequencer() runs them: a beat frame, then frames until the module is idle again. After every
+// frame the core must hold its invariants:
+//   - the master step is switched on, or -1 (HighSeqModule::checkInvariants())
+//   - every beat count is below its target unless a reset is pending, and repeat counts stay in range
+//   - the module goes idle again within SETTLE_FRAMES of a beat
+//   - a step visit nothing touched plays (repeats + 1) x bars x beats per bar beats of its sequencer
+//   - a bank song stored over while the leader plays it is not touched until the leader's next step
+//     boundary, where it takes the song as stored (StoredSong::loadedIn())
+// A follower module is driven from the leader's steps alongside, with its own switches.
+//
+//   make fuzz              standalone random driver under ASan/UBSan: ./fuzz [seconds] [seed]
+//   make fuzz-libfuzzer    libFuzzer entry point (clang): ./fuzz-libfuzzer [corpus dir or crash file]
+// A failing input is written to crash-<seed>-<input>.bin, which either build replays.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include "HighSeqModule.hpp"
+#include "SongBank.hpp"
+
+using namespace CLC_Synths;
+
+static const int SETTLE_FRAMES = 8;     // frames after a beat that stepSongSequencer() may run per frame
+static const int MAX_INPUT = 4096;
+
+enum FUZZOP {
+    FUZZ_BEAT_ALL,          // beat on every sequencer (the shared Beat input)
+    FUZZ_BEAT_SOME,         // beat on the sequencers in the next byte (own Beat inputs)
+    FUZZ_FRAME,             // a frame without a beat
+    FUZZ_RESET,
+    FUZZ_JUMP,
+    FUZZ_STEP_SEQ,          // edits from here on
+    FUZZ_STEP_REPEATS,
+    FUZZ_STEP_SWITCH,
+    FUZZ_BEATS_PER_BAR,
+    FUZZ_BARS,
+    FUZZ_MODULATION,
+    FUZZ_ORDER,
+    FUZZ_PROGRAM,
+    FUZZ_FOLLOWER_SWITCH,
+    FUZZ_SONG,              // a bank song for the leader at its next step boundary
+    FUZZ_STORE,             // a bank song stored, often the one the leader plays
+    NUM_FUZZ_OPS
+};
+
+static const char* const invariantNames[] = { "master step", "step", "sequencer" };
+
+class Input {
+    const uint8_t* data;
+    size_t size;
+    size_t at;
+public:
+    Input(const uint8_t* p_data, size_t p_size) : data(p_data), size(p_size), at(0) {}
+    bool more() const { return at < size; }
+    int byte() { return (at < size) ? data[at++] : 0; }
+    int below(int n) { return byte() % n; }
+};
+
+struct Harness {
+    HighSeqModule leader;
+    HighSeqModule follower;
+    SongProgram programs[2];
+    int program;                // programs[] entry the modules play, -1 = none
+
+    // the leader as lane 1 of the plugin, changing bank songs at step boundaries; grid edits leave it alone
+    // while it plays one
+    StoredSong bank[2];
+    int song;                   // bank[] entry the leader plays, -1 = its own grid
+    int requestedSong;          // entry it changes to at its next step boundary
+    bool songStale;             // the song it plays was stored over
+    bool songLoaded;            // a song was loaded since the visit started
+    StoredSong loaded;          // the song as the leader loaded it
+    int repeatOffset;
+    int barsOffset;
+    unsigned stepMask;
+
+    // the leader's step visit being measured
+    int visitStep;
+    int visitBeats;
+    int visitLength;
+    bool visitClean;            // nothing that changes its length has been touched since it started
+
+    int op;                     // operation being run, for the failure report
+    uint64_t frames;
+
+    Harness();
+    void fail(const char* what, int detail);
+    void check(const HighSeqModule& module, const char* which);
+    void frame(uint8_t beats, bool resetHigh, int jumpTo);
+    void settle();
+    void startVisit(bool clean);
+    void beat(uint8_t beats);
+    void edited();
+    void loadSong();
+    void checkSong();
+    void run(Input& input);
+};
+
+Harness::Harness() : program(-1), song(-1), requestedSong(-1), songStale(false), songLoaded(false), repeatOffset(0), barsOffset(0), stepMask(~0u), visitStep(-1), visitBeats(0),
+                     visitLength(0), visitClean(false), op(0), frames(0) {
+    // as constructSongSequencer(): every step on, then reset
+    leader.assertInitialized();
+    follower.assertInitialized();
+    bank[0].stored = false;
+    bank[1].stored = false;
+    leader.reset();
+    follower.reset();
+    settle();
+    startVisit(false);
+}
+
+void Harness::fail(const char* what, int detail) {
+    fprintf(stderr, "fuzz: %s (%d) at operation %d, frame %llu, master step %d\n", what, detail, op,
+            (unsigned long long) frames, leader.getMasterStep());
+    for (int step = 0; step < HighSeqModule::NUM_STEPS; step++) {
+        const MasterStep& s = leader.steps[step];
+        fprintf(stderr, "  step %d: seq %d repeats %d/%d %s\n", step + 1, s.getAssignedSeq(), s.getCountRepeats(),
+                s.getRepeats(), s.getOnOffSwitch() ? "on" : "off");
+    }
+    for (int seq = 0; seq < HighSeqModule::NUM_SEQUENCERS; seq++) {
+        const Sequencer& s = leader.sequencers[seq];
+        fprintf(stderr, "  seq %c: beat %d/%d%s\n", 'A' + seq, s.getbeatCount(), s.gettargetBeats(),
+                (s.getResetStatus() == SEQRESET::RESET) ? " reset" : "");
+    }
+    abort();
+}
+
+void Harness::check(const HighSeqModule& module, const char* which) {
+    int failed = module.checkInvariants();
+    for (int bit = 0; bit < 3; bit++) {
+        if (failed & (1 << bit)) {
+            fprintf(stderr, "fuzz: %s\n", which);
+            fail(invariantNames[bit], failed);
+        }
+    }
+}
+
+void Harness::frame(uint8_t beats, bool resetHigh, int jumpTo) {
+    // one frame of every lane, in the order stepSongSequencer() runs it
+    int before = leader.getMasterStep();
+    bool songDue = (song != requestedSong) || songStale;
+    bool loadedNow = false;
+    if (songDue && (before < 0 || resetHigh)) {
+        loadSong();   // nothing playing to cut short
+        loadedNow = true;
+    }
+    for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++) {
+        BEATSTATE state = (beats & (1 << s)) ? BEATSTATE::FIRSTHIGH : BEATSTATE::LOW;
+        leader.sequencers[s].set_beatState(state);
+        follower.sequencers[s].set_beatState(state);
+    }
+    leader.process();
+    if (resetHigh)
+        leader.reset();
+    if (jumpTo >= 0)
+        leader.jump(jumpTo);
+    int now = leader.getMasterStep();
+    if (songDue && !loadedNow && now >= 0 && now != before) {
+        // a step boundary: the step just started plays from the new song, or the song starts over
+        loadSong();
+        if (leader.steps[now].getOnOffSwitch() == SWITCHSTATE::ON)
+            leader.sequencers[leader.steps[now].getAssignedSeq()].reset();
+        else
+            leader.reset();
+    }
+    follower.follow(leader.getMasterStep());
+    if (resetHigh)
+        follower.requestSequencerResets();
+    frames++;
+    check(leader, "leader");
+    check(follower, "follower");
+    checkSong();
+}
+
+void Harness::loadSong() {
+    // as the plugin's loadSong(); going back to the leader's own grid keeps the grid as it is
+    song = requestedSong;
+    songStale = false;
+    songLoaded = true;
+    if (song < 0)
+        return;
+    bank[song].load(leader, 0);
+    loaded = bank[song];
+}
+
+void Harness::checkSong() {
+    if (song >= 0 && !loaded.loadedIn(leader, 0))
+        fail("bank song changed outside a step boundary", song);
+}
+
+void Harness::settle() {
+    // frames after an event until nothing is pending, as the per frame loop keeps running them
+    int frame = 0;
+    while (!leader.isIdle() || follower.hasPendingResets()) {
+        if (++frame > SETTLE_FRAMES)
+            fail("not idle after a beat", frame);
+        this->frame(0, false, -1);
+    }
+}
+
+void Harness::startVisit(bool clean) {
+    // a song loaded at the boundary restarts the step's sequencer part way through the beat, so the visit
+    // is not measured
+    visitStep = leader.getMasterStep();
+    visitBeats = 0;
+    visitClean = clean && (visitStep >= 0) && !songLoaded;
+    songLoaded = false;
+    if (visitStep >= 0) {
+        const MasterStep& step = leader.steps[visitStep];
+        visitLength = (step.getRepeats() + 1) * leader.sequencers[step.getAssignedSeq()].gettargetBeats();
+    }
+}
+
+void Harness::beat(uint8_t beats) {
+    // a step that takes over from none, or from a step switched off, joins its sequencer part way through
+    // its count, so only visits that follow a visit played out are measured
+    int step = leader.getMasterStep();
+    bool running = (step >= 0) && (leader.steps[step].getOnOffSwitch() == SWITCHSTATE::ON);
+    bool counted = running && (beats & (1 << leader.steps[step].getAssignedSeq()));
+    frame(beats, false, -1);
+    settle();
+    if (counted && step == visitStep)
+        visitBeats++;
+
+    int now = leader.getMasterStep();
+    if (now != visitStep) {
+        // the visit ended on this beat
+        if (visitClean && visitBeats != visitLength)
+            fail("step visit length", visitBeats - visitLength);
+        startVisit(running);
+    } else if (counted && leader.steps[now].getCountRepeats() == 0 &&
+               leader.sequencers[leader.steps[now].getAssignedSeq()].getbeatCount() == 0) {
+        // the step came round again: the only step on, or a program playing it twice running
+        if (visitClean && visitBeats != visitLength)
+            fail("step visit length", visitBeats - visitLength);
+        startVisit(true);
+    } else if (visitClean && visitBeats >= visitLength)
+        fail("step visit overran", visitBeats - visitLength);
+}
+
+void Harness::edited() {
+    // the plugin runs frame 0 of the next block to pick up an edit
+    int step = leader.getMasterStep();
+    frame(0, false, -1);
+    settle();
+    if (leader.getMasterStep() != step)
+        startVisit(false);
+}
+
+void Harness::run(Input& input) {
+    for (op = 0; input.more(); op++) {
+        int kind = input.below(NUM_FUZZ_OPS + 4);
+        if (kind >= NUM_FUZZ_OPS)
+            kind = FUZZ_BEAT_ALL;   // mostly beats, so songs get played through between edits
+        int step = input.below(HighSeqModule::NUM_STEPS);
+        int running = leader.getMasterStep();
+        bool touchesVisit = (step == running);
+        switch (kind) {
+            case FUZZ_BEAT_ALL:
+                beat(0xFF);
+                break;
+            case FUZZ_BEAT_SOME:
+                beat(input.byte());
+                break;
+            case FUZZ_FRAME:
+                frame(0, false, -1);
+                settle();
+                break;
+            case FUZZ_RESET:
+                frame(0, true, -1);
+                settle();
+                startVisit(true);
+                break;
+            case FUZZ_JUMP:
+                frame(0, false, step);
+                settle();
+                startVisit(true);
+                break;
+            case FUZZ_STEP_SEQ: {
+                int seq = input.below(HighSeqModule::NUM_SEQUENCERS);
+                if (song < 0)
+                    leader.steps[step].set_sequencer(seq);
+                follower.steps[step].set_sequencer(seq);
+                visitClean = visitClean && !touchesVisit;
+                break;
+            }
+            case FUZZ_STEP_REPEATS: {
+                int repeats = input.below(HighSeqModule::MAX_REPEATS + 1);
+                if (song < 0)
+                    leader.steps[step].set_repeats(repeats);
+                follower.steps[step].set_repeats(input.below(HighSeqModule::MAX_REPEATS + 1));
+                visitClean = visitClean && !touchesVisit;
+                break;
+            }
+            case FUZZ_STEP_SWITCH: {
+                int on = input.below(2);
+                if (song < 0)
+                    leader.steps[step].set_switch(static_cast<SWITCHSTATE>(on));
+                visitClean = visitClean && !touchesVisit;
+                break;
+            }
+            case FUZZ_FOLLOWER_SWITCH:
+                follower.steps[step].set_switch(static_cast<SWITCHSTATE>(input.below(2)));
+                break;
+            case FUZZ_BEATS_PER_BAR:
+            case FUZZ_BARS: {
+                int seq = step;
+                int value = 1 + input.below(Sequencer::MAX_BARS);
+                for (int m = (song < 0) ? 0 : 1; m < 2; m++) {
+                    HighSeqModule& module = m ? follower : leader;
+                    if (kind == FUZZ_BARS)
+                        module.sequencers[seq].set_bars(value);
+                    else
+                        module.sequencers[seq].set_beatsPerBar(value);
+                }
+                visitClean = visitClean && (running < 0 || leader.steps[running].getAssignedSeq() != seq);
+                break;
+            }
+            case FUZZ_MODULATION: {
+                // once per block in the plugin; the running step keeps its repeats, a bars change lands at
+                // the sequencer's next restart, which may be the running step's next repeat
+                int bars = input.below(2 * Sequencer::MAX_BARS + 1) - Sequencer::MAX_BARS;
+                repeatOffset = input.below(2 * MasterStep::MAX_REPEATS + 1) - MasterStep::MAX_REPEATS;
+                stepMask = input.byte();
+                stepMask = stepMask ? stepMask : ~0u;
+                if (bars != barsOffset)
+                    visitClean = false;
+                barsOffset = bars;
+                leader.setModulation(repeatOffset, barsOffset, stepMask);
+                follower.setModulation(repeatOffset, barsOffset, stepMask);
+                break;
+            }
+            case FUZZ_ORDER:
+                leader.setOrder(input.below(ORDER_RANDOM + 1), input.byte());
+                break;
+            case FUZZ_PROGRAM: {
+                // a fresh Arrangement into the buffer the lanes are not playing, or none
+                if (input.below(4) == 0) {
+                    program = -1;
+                    leader.setProgram(nullptr);
+                    break;
+                }
+                int16_t source[SongProgram::MAX_INSTRUCTIONS];
+                for (int i = 0; i < SongProgram::MAX_INSTRUCTIONS; i++)
+                    source[i] = input.below(SOURCE_END + 1);
+                program = (program == 0) ? 1 : 0;
+                programs[program].compile(source, SongProgram::MAX_INSTRUCTIONS);
+                leader.setProgram(programs[program].size() > 0 ? &programs[program] : nullptr);
+                break;
+            }
+            case FUZZ_SONG:
+                // a stored song, or back to the leader's own grid
+                requestedSong = input.below(3) - 1;
+                if (requestedSong >= 0 && !bank[requestedSong].stored)
+                    requestedSong = -1;
+                break;
+            case FUZZ_STORE: {
+                // as storeSong() at the start of a block, mostly into the song being played
+                int into = (song >= 0 && input.below(4) != 0) ? song : input.below(2);
+                StoredSong& stored = bank[into];
+                for (int s = 0; s < HighSeqModule::NUM_SEQUENCERS; s++) {
+                    stored.beatsPerBar[s] = 1 + input.below(Sequencer::MAX_BARS);
+                    stored.bars[s] = 1 + input.below(Sequencer::MAX_BARS);
+                    stored.selectValue[s] = 1;
+                }
+                for (int i = 0; i < HighSeqModule::NUM_STEPS; i++) {
+                    stored.stepSeq[0][i] = input.below(HighSeqModule::NUM_SEQUENCERS);
+                    stored.stepRepeats[0][i] = input.below(HighSeqModule::MAX_REPEATS + 1);
+                    stored.stepSwitch[0][i] = input.below(2);
+                }
+                stored.stored = true;
+                if (into == song)
+                    songStale = true;
+                checkSong();
+                break;
+            }
+        }
+        if (kind >= FUZZ_STEP_SEQ)
+            edited();
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    Harness* harness = new Harness();
+    Input input(data, size);
+    harness->run(input);
+    delete harness;
+    return 0;
+}
+
+#ifndef SONGSEQ_LIBFUZZER
+
+static uint32_t nextRandom(uint32_t& state) {
+    // xorshift32
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static const uint8_t* failingInput = nullptr;
+static size_t failingSize = 0;
+static char failingName[64];
+
+static void saveFailingInput(int) {
+    // SIGABRT from Harness::fail() or a sanitizer: keep the input for a replay
+    if (failingInput) {
+        FILE* file = fopen(failingName, "wb");
+        if (file) {
+            fwrite(failingInput, 1, failingSize, file);
+            fclose(file);
+            fprintf(stderr, "fuzz: input written to %s\n", failingName);
+        }
+    }
+    signal(SIGABRT, SIG_DFL);
+    abort();
+}
+
+int main(int argc, char** argv) {
+    // ./fuzz [seconds] [seed], or ./fuzz file... to replay inputs
+    if (argc > 1 && !(argv[1][0] >= '0' && argv[1][0] <= '9')) {
+        for (int i = 1; i < argc; i++) {
+            static uint8_t data[1 << 20];
+            FILE* file = fopen(argv[i], "rb");
+            if (!file) {
+                perror(argv[i]);
+                return 1;
+            }
+            size_t size = fread(data, 1, sizeof(data), file);
+            fclose(file);
+            LLVMFuzzerTestOneInput(data, size);
+            printf("%s: ok\n", argv[i]);
+        }
+        return 0;
+    }
+    double seconds = (argc > 1) ? atof(argv[1]) : 10.0;
+    uint32_t seed = (argc > 2) ? strtoul(argv[2], nullptr, 10) : (uint32_t) time(nullptr);
+    uint32_t state = seed ? seed : 1;
+    signal(SIGABRT, saveFailingInput);
+
+    static uint8_t data[MAX_INPUT];
+    uint64_t inputs = 0;
+    uint64_t operations = 0;
+    uint64_t frames = 0;
+    clock_t start = clock();
+    clock_t end = start + (clock_t) (seconds * CLOCKS_PER_SEC);
+    while (clock() < end) {
+        size_t size = 1 + nextRandom(state) % MAX_INPUT;
+        for (size_t i = 0; i < size; i++)
+            data[i] = nextRandom(state) >> 24;
+        failingInput = data;
+        failingSize = size;
+        snprintf(failingName, sizeof(failingName), "crash-%u-%llu.bin", seed, (unsigned long long) inputs);
+        Harness harness;
+        Input input(data, size);
+        harness.run(input);
+        inputs++;
+        operations += harness.op;
+        frames += harness.frames;
+    }
+    double elapsed = (double) (clock() - start) / CLOCKS_PER_SEC;
+    printf("seed %u: %llu inputs, %llu operations, %llu frames in %.1f s (%.2f M events/s), no failures\n", seed,
+           (unsigned long long) inputs, (unsigned long long) operations, (unsigned long long) frames, elapsed,
+           (operations + frames) / elapsed / 1e6);
+    return 0;
+}
+
+#endif
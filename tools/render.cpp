@@ -0,0 +1,407 @@
+// Host batch renderer: plays every preset of a library through the whole plugin on the same input stimuli,
+// one SongSequencer instance per worker thread, and prints a summary of each for nightly comparisons:
+//   - song: beats from one pass start to the next, taken from lane 1's End Gate
+//   - timeline: the beat each step of lane 1 came up on, taken from its Step CV
+//   - checksums: FNV-1a over every frame of each output bus the preset routes
+//   - latency: the plugin's own beat to step change and beat to reset trigger histograms, as the
+//     diagnostics page shows them, in frames (early = a reset trigger started ahead of its beat)
+//   - with -t: the Trace specification set to that many units for every preset, and the records left in
+//     the trace ring at the end printed oldest first, one TraceBuffer::format() line each
+// Lines are printed in preset name order whatever the thread count, and timing goes to stderr, so two
+// runs diff cleanly.
+//
+//   make render    ./render [-j threads] [-s stimuli file] [-t trace units] preset file or directory...
+//
+// A preset is a text file of "Name = value" lines, # starting a comment. Names are parameter names as the
+// NT shows them ("Step1 Seq", "Step Order") or specifications ("Lanes", "Songs", "Voices"); an enum
+// parameter takes a value name ("Step Order = Random") or a number. Sync is always Off, as instances
+// on different threads cannot share a sync group. A preset that leaves the Step CV or End Gate output
+// unrouted has it sent to the highest bus nothing else uses.
+//
+// Stimuli lines, shared by every preset:
+//   beat <bus> <period> [phase]    10V for half of every period frames, the first starting at phase
+//   reset <bus> <frame> <frames>   10V from frame for frames
+//   cv <bus> <frame> <volts>       the bus holds volts from frame on
+//   frames <count>                 length of the render
+//   block <frames>                 frames per step() call, a multiple of 4 up to 128
+// Without a file: beat on bus 2 every 2400 frames from frame 1200, reset on bus 1 for the first 64 frames,
+// 256 beats in blocks of 32 frames.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "HostNT.hpp"
+
+static const int MAX_TIMELINE = 64;     // step changes printed per preset
+static const char* const latencyBuckets[CLC_Synths::LATENCY_BUCKETS] = { "early", "0", "1", "2", "3", "4..7", "8..15", "16+" };
+static const uint32_t FNV_OFFSET = 2166136261u;
+static const uint32_t FNV_PRIME = 16777619u;
+
+struct Stimulus {
+    enum { BEAT, RESET, CV } kind;
+    int bus;                // 0 based
+    uint32_t start;
+    uint32_t length;        // BEAT: period, RESET: frames
+    float volts;
+};
+
+struct Stimuli {
+    std::vector<Stimulus> list;
+    uint32_t frames;
+    int block;
+    int beatBus;            // the first beat stimulus, counted for the summary; -1 = count frames instead
+
+    float level(const Stimulus& s, uint32_t frame) const {
+        if (frame < s.start)
+            return 0.f;
+        switch (s.kind) {
+            case Stimulus::BEAT: return ((frame - s.start) % s.length < s.length / 2) ? 10.f : 0.f;
+            case Stimulus::RESET: return (frame - s.start < s.length) ? 10.f : 0.f;
+            default: return s.volts;
+        }
+    }
+    void fill(float* busFrames, uint32_t first, int numFrames) const {
+        memset(busFrames, 0, HOST_BUSES * numFrames * sizeof(float));
+        for (size_t i = 0; i < list.size(); i++) {
+            float* bus = busFrames + list[i].bus * numFrames;
+            for (int frame = 0; frame < numFrames; frame++)
+                bus[frame] += level(list[i], first + frame);
+        }
+    }
+};
+
+struct Preset {
+    std::string name;
+    std::string path;
+    std::string summary;
+    bool failed;
+};
+
+static bool loadStimuli(const char* path, Stimuli& stimuli) {
+    stimuli.list.clear();
+    stimuli.frames = 0;
+    stimuli.block = 32;
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    char line[256];
+    for (int number = 1; fgets(line, sizeof(line), file); number++) {
+        char* text = hostTrim(line);
+        char* comment = strchr(text, '#');
+        if (comment)
+            *comment = '\0';
+        char word[16];
+        int bus = 0;
+        double a = 0, b = 0;
+        int count = sscanf(text, "%15s %d %lf %lf", word, &bus, &a, &b);
+        if (count <= 0)
+            continue;
+        Stimulus s = Stimulus();
+        s.bus = bus - 1;
+        bool ok = (bus >= 1 && bus <= HOST_BUSES);
+        if (strcmp(word, "beat") == 0 && count >= 3 && a >= 2) {
+            s.kind = Stimulus::BEAT;
+            s.length = (uint32_t) a;
+            s.start = (count >= 4) ? (uint32_t) b : 0;
+        } else if (strcmp(word, "reset") == 0 && count == 4) {
+            s.kind = Stimulus::RESET;
+            s.start = (uint32_t) a;
+            s.length = (uint32_t) b;
+        } else if (strcmp(word, "cv") == 0 && count == 4) {
+            s.kind = Stimulus::CV;
+            s.start = (uint32_t) a;
+            s.volts = (float) b;
+        } else if (strcmp(word, "frames") == 0 && count == 2) {
+            stimuli.frames = bus;
+            continue;
+        } else if (strcmp(word, "block") == 0 && count == 2) {
+            stimuli.block = bus;
+            ok = (bus >= 4 && bus <= (int) HOST_MAX_FRAMES && bus % 4 == 0);
+            if (ok)
+                continue;
+        } else
+            ok = false;
+        if (!ok) {
+            fprintf(stderr, "%s:%d: bad stimulus\n", path, number);
+            fclose(file);
+            return false;
+        }
+        stimuli.list.push_back(s);
+    }
+    fclose(file);
+    return true;
+}
+
+static void defaultStimuli(Stimuli& stimuli) {
+    Stimulus beat = { Stimulus::BEAT, 1, 1200, 2400, 0.f };
+    Stimulus reset = { Stimulus::RESET, 0, 0, 64, 0.f };
+    stimuli.list.push_back(beat);
+    stimuli.list.push_back(reset);
+    stimuli.frames = 256 * 2400;
+    stimuli.block = 32;
+}
+
+static void render(const Stimuli& stimuli, int traceUnits, Preset& preset) {
+    char text[256];
+    preset.failed = true;
+
+    // the specifications decide the parameters there are, so they are read before the instance is built
+    int32_t specifications[8];
+    hostDefaultSpecifications(specifications);
+    HostSettings settings;
+    std::string error;
+    if (!hostReadPreset(preset.path.c_str(), specifications, settings, error)) {
+        preset.summary = preset.name + ": " + error;
+        return;
+    }
+    if (traceUnits >= 0) {
+        snprintf(text, sizeof(text), "%d", traceUnits);
+        hostSpecification("Trace", text, specifications);
+    }
+    HostInstance instance(specifications);
+    if (!hostApply(instance, settings, error)) {
+        preset.summary = preset.name + ": " + error;
+        return;
+    }
+    instance.set("Sync", "Off");
+
+    // buses for the Step CV and End Gate if the preset has none, and the outputs to checksum
+    bool used[HOST_BUSES + 1] = { false };
+    for (size_t i = 0; i < stimuli.list.size(); i++)
+        used[stimuli.list[i].bus + 1] = true;
+    for (int p = 0; p < instance.numParameters(); p++) {
+        if (hostIsBus(instance.algorithm->parameters[p]) && instance.get(p) <= HOST_BUSES)
+            used[instance.get(p)] = true;
+    }
+    int stepCV = instance.find("Step CV Output");
+    int endGate = instance.find("End Gate Output");
+    int routes[2] = { stepCV, endGate };
+    int free = HOST_BUSES;
+    for (int k = 0; k < 2; k++) {
+        if (instance.get(routes[k]) != 0)
+            continue;
+        while (free >= 1 && used[free])
+            free--;
+        if (free < 1) {
+            preset.summary = preset.name + ": no free bus for the Step CV or End Gate";
+            return;
+        }
+        instance.set(routes[k], free);
+        used[free] = true;
+    }
+    std::vector<int> outputs;
+    for (int p = 0; p < instance.numParameters(); p++) {
+        int bus = instance.get(p);
+        if (hostIsOutput(instance.algorithm->parameters[p]) && bus > 0 &&
+            std::find(outputs.begin(), outputs.end(), bus) == outputs.end())
+            outputs.push_back(bus);
+    }
+    std::sort(outputs.begin(), outputs.end());
+    std::vector<uint32_t> checksums(outputs.size(), FNV_OFFSET);
+
+    std::vector<float> busFrames(HOST_BUSES * stimuli.block);
+    int stepBus = instance.get(stepCV) - 1;
+    int endBus = instance.get(endGate) - 1;
+    uint32_t count = 0;             // beats, or frames without a beat stimulus
+    float lastBeat = 0.f;
+    float lastStep = 0.f;
+    bool lastEnd = false;
+    uint32_t passStart = 0;
+    int passStarts = 0;
+    uint32_t songLength = 0;
+    std::string timeline;
+    int changes = 0;
+    for (uint32_t first = 0; first < stimuli.frames; first += stimuli.block) {
+        int numFrames = stimuli.block;
+        stimuli.fill(busFrames.data(), first, numFrames);
+        std::vector<float> beat;
+        if (stimuli.beatBus >= 0)
+            beat.assign(busFrames.begin() + stimuli.beatBus * numFrames, busFrames.begin() + (stimuli.beatBus + 1) * numFrames);
+        instance.step(busFrames.data(), numFrames);
+
+        for (int frame = 0; frame < numFrames; frame++) {
+            if (stimuli.beatBus < 0)
+                count++;
+            else if (beat[frame] >= 3.f && lastBeat < 3.f)
+                count++;
+            if (stimuli.beatBus >= 0)
+                lastBeat = beat[frame];
+            float step = busFrames[stepBus * numFrames + frame];
+            if (step != lastStep) {
+                if (changes++ < MAX_TIMELINE) {
+                    snprintf(text, sizeof(text), " %u:%d", count, (int) step);
+                    timeline += text;
+                }
+                lastStep = step;
+            }
+            // a pass starts as the End Gate falls
+            bool end = busFrames[endBus * numFrames + frame] >= 3.f;
+            if (lastEnd && !end) {
+                if (++passStarts == 2)
+                    songLength = count - passStart;
+                passStart = count;
+            }
+            lastEnd = end;
+        }
+        for (size_t o = 0; o < outputs.size(); o++) {
+            const float* out = busFrames.data() + (outputs[o] - 1) * numFrames;
+            for (int frame = 0; frame < numFrames; frame++) {
+                uint32_t bits;
+                memcpy(&bits, &out[frame], sizeof(bits));
+                for (int byte = 0; byte < 4; byte++, bits >>= 8)
+                    checksums[o] = (checksums[o] ^ (bits & 0xFF)) * FNV_PRIME;
+            }
+        }
+    }
+
+    const char* unit = (stimuli.beatBus >= 0) ? "beats" : "frames";
+    if (passStarts >= 2)
+        snprintf(text, sizeof(text), "%s: song %u %s, %d step changes\n", preset.name.c_str(), songLength, unit, changes);
+    else
+        snprintf(text, sizeof(text), "%s: song did not come round, %d step changes\n", preset.name.c_str(), changes);
+    preset.summary = text;
+    preset.summary += "  timeline" + timeline + ((changes > MAX_TIMELINE) ? " ...\n" : "\n");
+    preset.summary += "  outputs";
+    for (size_t o = 0; o < outputs.size(); o++) {
+        snprintf(text, sizeof(text), " %d:%08x", outputs[o], checksums[o]);
+        preset.summary += text;
+    }
+    CLC_Synths::SongState state;
+    if (songSequencerLaneState(instance.algorithm, 0, state)) {
+        const uint32_t* histograms[2] = { state.stepLatency, state.resetLatency };
+        const char* names[2] = { "\n  latency step", ", reset" };
+        for (int h = 0; h < 2; h++) {
+            preset.summary += names[h];
+            for (int bucket = 0; bucket < CLC_Synths::LATENCY_BUCKETS; bucket++) {
+                snprintf(text, sizeof(text), " %s:%u", latencyBuckets[bucket], histograms[h][bucket]);
+                preset.summary += text;
+            }
+        }
+    }
+    const CLC_Synths::TraceBuffer& trace = songSequencerTrace(instance.algorithm);
+    if (traceUnits >= 0 && trace.enabled()) {
+        snprintf(text, sizeof(text), "\n  trace: %u records, the last %u", trace.written(), trace.written() - trace.oldest());
+        preset.summary += text;
+        for (uint32_t index = trace.oldest(); index < trace.written(); index++) {
+            CLC_Synths::TraceRecord record;
+            if (!trace.read(index, record))
+                continue;
+            CLC_Synths::TraceBuffer::format(record, text);
+            preset.summary += "\n    ";
+            preset.summary += text;
+        }
+    }
+    preset.failed = false;
+}
+
+static void addPresets(const char* path, std::vector<Preset>& presets) {
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        perror(path);
+        return;
+    }
+    if (!S_ISDIR(info.st_mode)) {
+        Preset preset;
+        const char* slash = strrchr(path, '/');
+        preset.name = slash ? slash + 1 : path;
+        preset.path = path;
+        preset.failed = true;
+        presets.push_back(preset);
+        return;
+    }
+    DIR* dir = opendir(path);
+    if (!dir) {
+        perror(path);
+        return;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.')
+            continue;
+        std::string file = std::string(path) + "/" + entry->d_name;
+        if (stat(file.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+            Preset preset;
+            preset.name = entry->d_name;
+            preset.path = file;
+            preset.failed = true;
+            presets.push_back(preset);
+        }
+    }
+    closedir(dir);
+}
+
+int main(int argc, char** argv) {
+    int threads = (int) std::thread::hardware_concurrency();
+    threads = (threads > 0) ? threads : 1;
+    Stimuli stimuli;
+    defaultStimuli(stimuli);
+    int traceUnits = -1;            // -1: the presets' own Trace, not printed
+    const char* usage = "usage: %s [-j threads] [-s stimuli file] [-t trace units] preset file or directory...\n";
+    int opt;
+    while ((opt = getopt(argc, argv, "j:s:t:")) != -1) {
+        switch (opt) {
+            case 'j':
+                threads = atoi(optarg);
+                break;
+            case 's':
+                if (!loadStimuli(optarg, stimuli))
+                    return 2;
+                break;
+            case 't':
+                traceUnits = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, usage, argv[0]);
+                return 2;
+        }
+    }
+    if (optind >= argc || threads < 1 || traceUnits < -1) {
+        fprintf(stderr, usage, argv[0]);
+        return 2;
+    }
+    stimuli.beatBus = -1;
+    for (size_t i = 0; i < stimuli.list.size() && stimuli.beatBus < 0; i++) {
+        if (stimuli.list[i].kind == Stimulus::BEAT)
+            stimuli.beatBus = stimuli.list[i].bus;
+    }
+
+    std::vector<Preset> presets;
+    for (int i = optind; i < argc; i++)
+        addPresets(argv[i], presets);
+    std::sort(presets.begin(), presets.end(), [](const Preset& a, const Preset& b) { return a.name < b.name; });
+    hostFactory();
+
+    // each worker takes the next preset not yet started
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&]() {
+            for (size_t i = next++; i < presets.size(); i = next++)
+                render(stimuli, traceUnits, presets[i]);
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int failed = 0;
+    for (size_t i = 0; i < presets.size(); i++) {
+        printf("%s\n", presets[i].summary.c_str());
+        failed += presets[i].failed;
+    }
+    fprintf(stderr, "%zu presets, %u frames each, on %d threads in %.2f s\n", presets.size(), stimuli.frames, threads, seconds);
+    return failed ? 1 : 0;
+}
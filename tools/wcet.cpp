@@ -0,0 +1,335 @@
+// Host worst case driver: runs the whole plugin through the inputs and edits that make step() do the most
+// work in one block, and reports the most cycles any block took against the NT's largest block.
+//
+//   make wcet    ./wcet [-c ceiling] [-b block frames] [-f frames] [-r runs] [-s scenario]
+//
+// Every scenario runs 4 lanes with 8 voices and the trace on, for -f frames (default 96000) in blocks of 4
+// frames and of maxFramesPerStep, or of -b frames. The Beat input gets a beat every 240 frames unless the
+// scenario asks for more:
+//   jumps        Jump triggers every 8 frames, Jump Quantize Immediate, to a different step each time
+//   repeats      every step of every lane on 16 repeats, one beat per bar, and the Repeats CV at its most
+//   loops        an Arrangement of four nested Loop .. Next x8 around two steps, one beat per bar
+//   beats        a beat every other frame
+//   reset        the Reset input held high throughout
+//   routed       every input and output routed, inputs on moving CVs, quantizers on, Random step order
+//   switch       the running step of each lane switched off after every block, back on three blocks later
+//   edits        one parameter changed between every two blocks, all parameters in turn
+//   all          all of the above at once
+// Each run is played -r times (default 5) on fresh instances and each block counts the least it took over
+// the runs, so a block the host interrupted does not stand in for the plugin's own worst case. A block's
+// budget is its share of a maxFramesPerStep block, so -c takes cycles per frame: any block over the ceiling
+// times its frames fails the run with exit status 1.
+//
+// The cycle figures are hostCycles(): the TSC on x86. The ceiling for a given NT is found by running this
+// alongside a profiling build on the module (make DEFINES=-DSONGSEQ_PROFILE, Diagnostics page Worst).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "HostNT.hpp"
+
+enum {
+    JUMPS = 1 << 0,
+    MAX_REPEATS = 1 << 1,
+    LOOPS = 1 << 2,
+    FAST_BEATS = 1 << 3,
+    RESET_HELD = 1 << 4,
+    ALL_ROUTED = 1 << 5,
+    SWITCH_OFF = 1 << 6,
+    EDITS = 1 << 7,
+    ALL = (1 << 8) - 1,
+};
+
+struct Scenario {
+    const char* name;
+    int flags;
+};
+
+static const Scenario scenarios[] = {
+    { "jumps", JUMPS },
+    { "repeats", MAX_REPEATS },
+    { "loops", LOOPS },
+    { "beats", FAST_BEATS },
+    { "reset", RESET_HELD },
+    { "routed", ALL_ROUTED },
+    { "switch", SWITCH_OFF },
+    { "edits", EDITS },
+    { "all", ALL },
+};
+
+static const int LANES = 4;
+static const uint32_t BEAT_PERIOD = 240;
+static const uint32_t JUMP_PERIOD = 8;
+static const int STEPS = 8;
+static const int SEQUENCERS = 8;
+static const int SWITCH_BACK_BLOCKS = 3;
+
+// buses: 1 Reset, 2 Beat, 3..12 moving CVs for routed inputs, 13..18 outputs, 19 Jump CV, 20 Jump Trigger,
+// 21 Repeats CV, 25..28 the lanes' Step CVs
+static const int CV_FIRST_BUS = 3;
+static const int CV_LAST_BUS = 12;
+static const int OUTPUT_FIRST_BUS = 13;
+static const int OUTPUT_LAST_BUS = 18;
+static const int JUMP_CV_BUS = 19;
+static const int JUMP_TRIGGER_BUS = 20;
+static const int REPEATS_CV_BUS = 21;
+static const int STEP_CV_FIRST_BUS = 25;
+
+static const char* const loopProgram[] = {
+    "Loop", "Loop", "Loop", "Loop", "Step 1", "Step 2", "Next x8", "Next x8", "Next x8", "Next x8", "Goto 1",
+};
+
+// parameters edits never touch: they change the clock, the sync group or the bank rather than the song
+static const char* const fixedParameters[] = {
+    "Sync", "Sync Group", "Clock", "Tempo", "Song", "Store Song", "Song MIDI Channel",
+};
+
+// lane 1's parameters are named as they are, lanes 2.. start "L2 " and so on
+static std::string laneName(int lane, const char* name) {
+    char text[64];
+    if (lane == 0)
+        snprintf(text, sizeof(text), "%s", name);
+    else
+        snprintf(text, sizeof(text), "L%d %s", lane + 1, name);
+    return text;
+}
+
+static void set(HostInstance& instance, const std::string& name, const char* value) {
+    if (!instance.set(name.c_str(), value)) {
+        fprintf(stderr, "cannot set '%s = %s'\n", name.c_str(), value);
+        exit(2);
+    }
+}
+
+static void setup(HostInstance& instance, int flags, std::vector<int>& edits) {
+    char value[16];
+    set(instance, "Sync", "Off");
+    for (int lane = 0; lane < LANES; lane++) {
+        snprintf(value, sizeof(value), "%d", STEP_CV_FIRST_BUS + lane);
+        set(instance, laneName(lane, "Step CV Output"), value);
+    }
+    if (flags & JUMPS) {
+        snprintf(value, sizeof(value), "%d", JUMP_CV_BUS);
+        set(instance, "Jump CV Input", value);
+        snprintf(value, sizeof(value), "%d", JUMP_TRIGGER_BUS);
+        set(instance, "Jump Trigger Input", value);
+        set(instance, "Jump Quantize", "Immediate");
+    }
+    if (flags & (MAX_REPEATS | LOOPS)) {
+        for (int s = 0; s < SEQUENCERS; s++) {
+            snprintf(value, sizeof(value), "Seq %c Beats/Bar", 'A' + s);
+            set(instance, value, "1");
+        }
+    }
+    if (flags & MAX_REPEATS) {
+        for (int lane = 0; lane < LANES; lane++) {
+            for (int step = 0; step < STEPS; step++) {
+                snprintf(value, sizeof(value), "Step%d Repeats", step + 1);
+                set(instance, laneName(lane, value), "16");
+            }
+        }
+        snprintf(value, sizeof(value), "%d", REPEATS_CV_BUS);
+        set(instance, "Repeats CV Input", value);
+    }
+    if (flags & LOOPS) {
+        for (size_t i = 0; i < sizeof(loopProgram) / sizeof(loopProgram[0]); i++) {
+            snprintf(value, sizeof(value), "Arrangement %d", (int) i + 1);
+            set(instance, value, loopProgram[i]);
+        }
+    }
+    if (flags & ALL_ROUTED) {
+        set(instance, "Step Order", "Random");
+        for (int lane = 0; lane < LANES; lane++)
+            set(instance, laneName(lane, "Quantize Scale"), "Major");
+        int input = CV_FIRST_BUS;
+        int output = OUTPUT_FIRST_BUS;
+        for (int p = 0; p < instance.numParameters(); p++) {
+            const _NT_parameter& parameter = instance.algorithm->parameters[p];
+            if (!hostIsBus(parameter) || instance.get(p) != 0)
+                continue;
+            if (hostIsOutput(parameter)) {
+                instance.set(p, output);
+                output = (output == OUTPUT_LAST_BUS) ? OUTPUT_FIRST_BUS : output + 1;
+            } else {
+                instance.set(p, input);
+                input = (input == CV_LAST_BUS) ? CV_FIRST_BUS : input + 1;
+            }
+        }
+    }
+    edits.clear();
+    if (flags & EDITS) {
+        for (int p = 0; p < instance.numParameters(); p++) {
+            const _NT_parameter& parameter = instance.algorithm->parameters[p];
+            bool fixed = hostIsBus(parameter) || parameter.min == parameter.max;
+            for (size_t i = 0; i < sizeof(fixedParameters) / sizeof(fixedParameters[0]); i++)
+                fixed = fixed || strcmp(parameter.name, fixedParameters[i]) == 0;
+            if (!fixed)
+                edits.push_back(p);
+        }
+    }
+}
+
+static void fillInputs(float* busFrames, int flags, uint32_t first, int numFrames) {
+    for (int frame = 0; frame < numFrames; frame++) {
+        uint32_t at = first + frame;
+        busFrames[frame] = ((flags & RESET_HELD) || at < 64) ? 10.f : 0.f;
+        if (flags & FAST_BEATS)
+            busFrames[numFrames + frame] = (at & 1) ? 0.f : 10.f;
+        else
+            busFrames[numFrames + frame] = (at % BEAT_PERIOD < BEAT_PERIOD / 2) ? 10.f : 0.f;
+        if (flags & JUMPS) {
+            busFrames[(JUMP_TRIGGER_BUS - 1) * numFrames + frame] = (at % JUMP_PERIOD < JUMP_PERIOD / 2) ? 10.f : 0.f;
+            busFrames[(JUMP_CV_BUS - 1) * numFrames + frame] = (float) ((at / JUMP_PERIOD * 3) % STEPS + 1);
+        }
+        if (flags & MAX_REPEATS)
+            busFrames[(REPEATS_CV_BUS - 1) * numFrames + frame] = 10.f;
+        if (flags & ALL_ROUTED) {
+            for (int bus = CV_FIRST_BUS; bus <= CV_LAST_BUS; bus++)
+                busFrames[(bus - 1) * numFrames + frame] = (float) ((at * bus) % 4800) / 480.f;
+        }
+    }
+}
+
+static void afterBlock(HostInstance& instance, int flags, const std::vector<int>& edits, const float* busFrames,
+                       int numFrames, int block, std::vector<std::string>& switchedOff) {
+    if (flags & SWITCH_OFF) {
+        // back on what went off a few blocks ago, then off whatever each lane is playing now
+        size_t back = (size_t) (block % SWITCH_BACK_BLOCKS) * LANES;
+        for (int lane = 0; lane < LANES; lane++) {
+            std::string& name = switchedOff[back + lane];
+            if (!name.empty())
+                set(instance, name, "On");
+            name.clear();
+            int step = (int) roundf(busFrames[(STEP_CV_FIRST_BUS + lane - 1) * numFrames + numFrames - 1]);
+            if (step >= 1 && step <= STEPS) {
+                char value[16];
+                snprintf(value, sizeof(value), "Step%d Switch", step);
+                name = laneName(lane, value);
+                set(instance, name, "Off");
+            }
+        }
+    }
+    if ((flags & EDITS) && !edits.empty()) {
+        int p = edits[block % edits.size()];
+        const _NT_parameter& parameter = instance.algorithm->parameters[p];
+        int range = parameter.max - parameter.min + 1;
+        instance.set(p, parameter.min + (instance.get(p) - parameter.min + 1) % range);
+    }
+}
+
+// cycles each block took in one run from a fresh instance
+static void play(const int32_t* specifications, int flags, int numFrames, int blocks, std::vector<uint64_t>& cycles) {
+    HostInstance instance(specifications);
+    std::vector<int> edits;
+    setup(instance, flags, edits);
+    std::vector<float> busFrames(HOST_BUSES * numFrames, 0.f);
+    std::vector<std::string> switchedOff(SWITCH_BACK_BLOCKS * LANES);
+    for (int b = 0; b < blocks; b++) {
+        fillInputs(busFrames.data(), flags, (uint32_t) b * numFrames, numFrames);
+        uint64_t start = hostCycles();
+        instance.step(busFrames.data(), numFrames);
+        cycles[b] = hostCycles() - start;
+        afterBlock(instance, flags, edits, busFrames.data(), numFrames, b, switchedOff);
+    }
+}
+
+int main(int argc, char** argv) {
+    int ceiling = 0;
+    int blockFrames = 0;
+    int frames = 96000;
+    int runs = 5;
+    const char* only = nullptr;
+    const char* usage = "usage: %s [-c cycles per frame] [-b block frames] [-f frames] [-r runs] [-s scenario]\n";
+    int opt;
+    while ((opt = getopt(argc, argv, "c:b:f:r:s:")) != -1) {
+        switch (opt) {
+            case 'c': ceiling = atoi(optarg); break;
+            case 'b': blockFrames = atoi(optarg); break;
+            case 'f': frames = atoi(optarg); break;
+            case 'r': runs = atoi(optarg); break;
+            case 's': only = optarg; break;
+            default:
+                fprintf(stderr, usage, argv[0]);
+                return 2;
+        }
+    }
+    int maxFrames = (int) NT_globals.maxFramesPerStep;
+    if (optind != argc || ceiling < 0 || runs < 1 || frames < 1 ||
+        (blockFrames != 0 && (blockFrames < 4 || blockFrames > maxFrames || blockFrames % 4 != 0))) {
+        fprintf(stderr, usage, argv[0]);
+        return 2;
+    }
+    std::vector<int> sizes;
+    if (blockFrames)
+        sizes.push_back(blockFrames);
+    else {
+        sizes.push_back(4);
+        sizes.push_back(maxFrames);
+    }
+
+    int32_t specifications[8];
+    hostDefaultSpecifications(specifications);
+    hostSpecification("Lanes", "4", specifications);
+    hostSpecification("Voices", "8", specifications);
+    hostSpecification("Trace", "64", specifications);
+
+    printf("%d lanes, 8 voices, trace on; %d frames a run, each block the least of %d runs; full block %d frames\n",
+           LANES, frames, runs, maxFrames);
+    printf("scenario  block  worst block  cycles/frame  full block%s\n", ceiling ? "  over ceiling" : "");
+    bool found = false;
+    int overTotal = 0;
+    double worstPerFrame = 0;
+    std::string worstName;
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        if (only && strcmp(only, scenarios[s].name) != 0)
+            continue;
+        found = true;
+        for (size_t z = 0; z < sizes.size(); z++) {
+            int numFrames = sizes[z];
+            int blocks = (frames + numFrames - 1) / numFrames;
+            std::vector<uint64_t> least(blocks, UINT64_MAX);
+            std::vector<uint64_t> cycles(blocks);
+            for (int r = 0; r < runs; r++) {
+                play(specifications, scenarios[s].flags, numFrames, blocks, cycles);
+                for (int b = 0; b < blocks; b++)
+                    least[b] = (cycles[b] < least[b]) ? cycles[b] : least[b];
+            }
+            uint64_t worst = 0;
+            int over = 0;
+            for (int b = 0; b < blocks; b++) {
+                worst = (least[b] > worst) ? least[b] : worst;
+                if (ceiling && least[b] > (uint64_t) ceiling * numFrames)
+                    over++;
+            }
+            double perFrame = (double) worst / numFrames;
+            printf("%-8s  %5d  %11llu  %12.1f  %10.0f", scenarios[s].name, numFrames, (unsigned long long) worst, perFrame,
+                   perFrame * maxFrames);
+            if (ceiling)
+                printf("  %13d", over);
+            printf("\n");
+            overTotal += over;
+            if (perFrame > worstPerFrame) {
+                worstPerFrame = perFrame;
+                worstName = scenarios[s].name;
+            }
+        }
+    }
+    if (!found) {
+        fprintf(stderr, "no scenario '%s'\n", only);
+        return 2;
+    }
+    printf("worst: %s, %.1f cycles per frame, %.0f for a %d frame block\n", worstName.c_str(), worstPerFrame,
+           worstPerFrame * maxFrames, maxFrames);
+    if (ceiling) {
+        printf("ceiling %d cycles per frame (%d for a %d frame block): %d block%s over\n", ceiling, ceiling * maxFrames,
+               maxFrames, overTotal, (overTotal == 1) ? "" : "s");
+        if (overTotal > 0)
+            return 1;
+    }
+    return 0;
+}